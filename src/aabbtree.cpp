@@ -0,0 +1,265 @@
+/**
+@file
+@brief implementation of dynamic bounding volume hierarchy
+@author Sergei Kachkov
+*/
+#include <algorithm>
+#include "aabbtree.h"
+
+const size_t AABBTree::null;
+
+AABBTree::AABBTree () :
+	root (null),
+	free_list (null)
+{
+}
+
+BoundingBox AABBTree::Union (BoundingBox a, BoundingBox b)
+{
+	return BoundingBox (vector2d (std::min (a.lb.x, b.lb.x), std::min (a.lb.y, b.lb.y)),
+						vector2d (std::max (a.rt.x, b.rt.x), std::max (a.rt.y, b.rt.y)));
+}
+
+double AABBTree::Perimeter (BoundingBox box)
+{
+	return 2.0 * ((box.rt.x - box.lb.x) + (box.rt.y - box.lb.y));
+}
+
+size_t AABBTree::AllocateNode ()
+{
+	size_t node;
+	if (free_list != null)
+	{
+		node = free_list;
+		free_list = nodes[node].parent;
+	}
+	else
+	{
+		node = nodes.size ();
+		nodes.push_back (Node ());
+	}
+	nodes[node].parent = nodes[node].child1 = nodes[node].child2 = null;
+	nodes[node].height = 0;
+	nodes[node].data = null;
+	return node;
+}
+
+void AABBTree::FreeNode (size_t node)
+{
+	//free nodes are linked through parent field
+	nodes[node].parent = free_list;
+	nodes[node].height = -1;
+	free_list = node;
+}
+
+size_t AABBTree::CreateProxy (BoundingBox box, size_t data)
+{
+	size_t proxy = AllocateNode ();
+	nodes[proxy].box = box;
+	nodes[proxy].data = data;
+	InsertLeaf (proxy);
+	return proxy;
+}
+
+void AABBTree::DestroyProxy (size_t proxy)
+{
+	RemoveLeaf (proxy);
+	FreeNode (proxy);
+}
+
+void AABBTree::MoveProxy (size_t proxy, BoundingBox box)
+{
+	RemoveLeaf (proxy);
+	nodes[proxy].box = box;
+	InsertLeaf (proxy);
+}
+
+void AABBTree::InsertLeaf (size_t leaf)
+{
+	if (root == null)
+	{
+		root = leaf;
+		nodes[root].parent = null;
+		return;
+	}
+
+	//find the best sibling by cost of perimeters
+	BoundingBox box = nodes[leaf].box;
+	size_t index = root;
+	while (!nodes[index].IsLeaf ())
+	{
+		size_t child1 = nodes[index].child1, child2 = nodes[index].child2;
+		double area = Perimeter (nodes[index].box);
+		double combined_area = Perimeter (Union (nodes[index].box, box));
+		//cost of creating new parent for this node and the leaf
+		double cost = 2.0 * combined_area;
+		//minimum cost of pushing the leaf further down the tree
+		double inheritance_cost = 2.0 * (combined_area - area);
+
+		double cost1 = Perimeter (Union (box, nodes[child1].box)) + inheritance_cost;
+		if (!nodes[child1].IsLeaf ())
+			cost1 -= Perimeter (nodes[child1].box);
+		double cost2 = Perimeter (Union (box, nodes[child2].box)) + inheritance_cost;
+		if (!nodes[child2].IsLeaf ())
+			cost2 -= Perimeter (nodes[child2].box);
+
+		if (cost < cost1 && cost < cost2)
+			break;
+		index = (cost1 < cost2) ? child1 : child2;
+	}
+	size_t sibling = index;
+
+	//new parent of sibling and leaf
+	size_t old_parent = nodes[sibling].parent;
+	size_t new_parent = AllocateNode ();
+	nodes[new_parent].parent = old_parent;
+	nodes[new_parent].box = Union (box, nodes[sibling].box);
+	nodes[new_parent].height = nodes[sibling].height + 1;
+	nodes[new_parent].child1 = sibling;
+	nodes[new_parent].child2 = leaf;
+	nodes[sibling].parent = new_parent;
+	nodes[leaf].parent = new_parent;
+	if (old_parent != null)
+	{
+		if (nodes[old_parent].child1 == sibling)
+			nodes[old_parent].child1 = new_parent;
+		else
+			nodes[old_parent].child2 = new_parent;
+	}
+	else
+		root = new_parent;
+
+	//fix heights and boxes of ancestors
+	index = nodes[leaf].parent;
+	while (index != null)
+	{
+		index = Balance (index);
+		size_t child1 = nodes[index].child1, child2 = nodes[index].child2;
+		nodes[index].height = 1 + std::max (nodes[child1].height, nodes[child2].height);
+		nodes[index].box = Union (nodes[child1].box, nodes[child2].box);
+		index = nodes[index].parent;
+	}
+}
+
+void AABBTree::RemoveLeaf (size_t leaf)
+{
+	if (leaf == root)
+	{
+		root = null;
+		return;
+	}
+
+	size_t parent = nodes[leaf].parent;
+	size_t grand_parent = nodes[parent].parent;
+	size_t sibling = (nodes[parent].child1 == leaf) ? nodes[parent].child2 : nodes[parent].child1;
+
+	if (grand_parent != null)
+	{
+		//parent is replaced by sibling
+		if (nodes[grand_parent].child1 == parent)
+			nodes[grand_parent].child1 = sibling;
+		else
+			nodes[grand_parent].child2 = sibling;
+		nodes[sibling].parent = grand_parent;
+		FreeNode (parent);
+
+		size_t index = grand_parent;
+		while (index != null)
+		{
+			index = Balance (index);
+			size_t child1 = nodes[index].child1, child2 = nodes[index].child2;
+			nodes[index].box = Union (nodes[child1].box, nodes[child2].box);
+			nodes[index].height = 1 + std::max (nodes[child1].height, nodes[child2].height);
+			index = nodes[index].parent;
+		}
+	}
+	else
+	{
+		root = sibling;
+		nodes[sibling].parent = null;
+		FreeNode (parent);
+	}
+}
+
+size_t AABBTree::Balance (size_t a)
+{
+	if (nodes[a].IsLeaf () || nodes[a].height < 2)
+		return a;
+
+	size_t b = nodes[a].child1, c = nodes[a].child2;
+	int balance = nodes[c].height - nodes[b].height;
+
+	//rotate c up
+	if (balance > 1)
+	{
+		size_t f = nodes[c].child1, g = nodes[c].child2;
+		nodes[c].child1 = a;
+		nodes[c].parent = nodes[a].parent;
+		nodes[a].parent = c;
+		if (nodes[c].parent != null)
+		{
+			if (nodes[nodes[c].parent].child1 == a)
+				nodes[nodes[c].parent].child1 = c;
+			else
+				nodes[nodes[c].parent].child2 = c;
+		}
+		else
+			root = c;
+
+		//the higher child of c stays under c, the other one goes to a
+		if (nodes[f].height > nodes[g].height)
+		{
+			nodes[c].child2 = f;
+			nodes[a].child2 = g;
+			nodes[g].parent = a;
+		}
+		else
+		{
+			nodes[c].child2 = g;
+			nodes[a].child2 = f;
+			nodes[f].parent = a;
+		}
+		nodes[a].box = Union (nodes[b].box, nodes[nodes[a].child2].box);
+		nodes[a].height = 1 + std::max (nodes[b].height, nodes[nodes[a].child2].height);
+		nodes[c].box = Union (nodes[a].box, nodes[nodes[c].child2].box);
+		nodes[c].height = 1 + std::max (nodes[a].height, nodes[nodes[c].child2].height);
+		return c;
+	}
+
+	//rotate b up
+	if (balance < -1)
+	{
+		size_t d = nodes[b].child1, e = nodes[b].child2;
+		nodes[b].child1 = a;
+		nodes[b].parent = nodes[a].parent;
+		nodes[a].parent = b;
+		if (nodes[b].parent != null)
+		{
+			if (nodes[nodes[b].parent].child1 == a)
+				nodes[nodes[b].parent].child1 = b;
+			else
+				nodes[nodes[b].parent].child2 = b;
+		}
+		else
+			root = b;
+
+		if (nodes[d].height > nodes[e].height)
+		{
+			nodes[b].child2 = d;
+			nodes[a].child1 = e;
+			nodes[e].parent = a;
+		}
+		else
+		{
+			nodes[b].child2 = e;
+			nodes[a].child1 = d;
+			nodes[d].parent = a;
+		}
+		nodes[a].box = Union (nodes[c].box, nodes[nodes[a].child1].box);
+		nodes[a].height = 1 + std::max (nodes[c].height, nodes[nodes[a].child1].height);
+		nodes[b].box = Union (nodes[a].box, nodes[nodes[b].child2].box);
+		nodes[b].height = 1 + std::max (nodes[a].height, nodes[nodes[b].child2].height);
+		return b;
+	}
+	return a;
+}
@@ -0,0 +1,186 @@
+/**
+@file
+@brief dynamic bounding volume hierarchy
+@author Sergei Kachkov
+*/
+#pragma once
+#include <vector>
+#include "vector.h"
+#include "boundingbox.h"
+
+/**
+@class
+@brief balanced binary tree of bounding boxes; leaves (proxies) hold index of body
+@note nodes are stored in array and reused through free list; tree is balanced by rotations
+*/
+class AABBTree
+{
+private:
+	struct Node
+	{
+		BoundingBox box;
+		size_t parent, child1, child2;
+		int height;
+		size_t data;
+		bool IsLeaf () const
+		{
+			return child1 == null;
+		}
+	};
+	std::vector<Node> nodes;
+	size_t root, free_list;
+	size_t AllocateNode ();
+	void FreeNode (size_t node);
+	void InsertLeaf (size_t leaf);
+	void RemoveLeaf (size_t leaf);
+	/**
+	@brief rotates subtree if it is unbalanced
+	@param node root of subtree
+	@return new root of subtree
+	*/
+	size_t Balance (size_t node);
+	static BoundingBox Union (BoundingBox a, BoundingBox b);
+	static double Perimeter (BoundingBox box);
+public:
+	static const size_t null = (size_t)-1;
+
+	AABBTree ();
+	/**
+	@return bytes of array of nodes
+	*/
+	size_t Memory () const
+	{
+		return nodes.capacity () * sizeof (Node);
+	}
+	/**
+	@brief adds leaf to tree
+	@param box bounding box of leaf
+	@param data user data (index of body)
+	@return id of proxy
+	*/
+	size_t CreateProxy (BoundingBox box, size_t data);
+	/**
+	@brief removes leaf from tree
+	@param proxy id of proxy
+	*/
+	void DestroyProxy (size_t proxy);
+	/**
+	@brief changes bounding box of leaf
+	@param proxy id of proxy
+	@param box new bounding box
+	*/
+	void MoveProxy (size_t proxy, BoundingBox box);
+	/**
+	@return bounding box of leaf
+	*/
+	BoundingBox GetBox (size_t proxy)
+	{
+		return nodes[proxy].box;
+	}
+	/**
+	@return user data of leaf
+	*/
+	size_t GetData (size_t proxy)
+	{
+		return nodes[proxy].data;
+	}
+	/**
+	@brief changes user data of leaf
+	*/
+	void SetData (size_t proxy, size_t data)
+	{
+		nodes[proxy].data = data;
+	}
+	/**
+	@brief calls callback (data) for every leaf which box intersects given box
+	@param box query box
+	@param callback function object; returns false to stop query
+	@note query doesn't modify tree, so several queries can run in parallel
+	*/
+	template <class Callback>
+	void Query (BoundingBox box, Callback callback) const
+	{
+		size_t stack[256];
+		size_t stack_size = 0;
+		if (root != null)
+			stack[stack_size++] = root;
+		while (stack_size)
+		{
+			const Node &node = nodes[stack[--stack_size]];
+			BoundingBox node_box = node.box;
+			if (!(node_box * box))
+				continue;
+			if (node.IsLeaf ())
+			{
+				if (!callback (node.data))
+					return;
+			}
+			else
+			{
+				stack[stack_size++] = node.child1;
+				stack[stack_size++] = node.child2;
+			}
+		}
+	}
+	/**
+	@brief calls callback (data, max_fraction) for every leaf which box intersects segment
+	@param from, to ends of segment
+	@param callback function object; returns new max fraction of segment (0 - from, 1 - to) that should be checked
+	@note returning 0 stops query; returning max_fraction continues it without clipping
+	*/
+	template <class Callback>
+	void RayCast (vector2d from, vector2d to, Callback callback) const
+	{
+		size_t stack[256];
+		size_t stack_size = 0;
+		if (root != null)
+			stack[stack_size++] = root;
+		double max_fraction = 1.0;
+		vector2d d = to - from;
+		while (stack_size)
+		{
+			const Node &node = nodes[stack[--stack_size]];
+			//slab test of clipped segment and box
+			double t_min = 0.0, t_max = max_fraction;
+			double origin[2] = {from.x, from.y}, direction[2] = {d.x, d.y};
+			double lb[2] = {node.box.lb.x, node.box.lb.y}, rt[2] = {node.box.rt.x, node.box.rt.y};
+			bool intersects = true;
+			for (int axis = 0; axis < 2 && intersects; axis++)
+			{
+				if (fabs (direction[axis]) < DBL_EPSILON)
+					intersects = origin[axis] >= lb[axis] && origin[axis] <= rt[axis];
+				else
+				{
+					double t1 = (lb[axis] - origin[axis]) / direction[axis];
+					double t2 = (rt[axis] - origin[axis]) / direction[axis];
+					if (t1 > t2)
+					{
+						double t = t1;
+						t1 = t2;
+						t2 = t;
+					}
+					if (t1 > t_min)
+						t_min = t1;
+					if (t2 < t_max)
+						t_max = t2;
+					intersects = t_min <= t_max;
+				}
+			}
+			if (!intersects)
+				continue;
+			if (node.IsLeaf ())
+			{
+				double fraction = callback (node.data, max_fraction);
+				if (fraction <= 0.0)
+					return;
+				if (fraction < max_fraction)
+					max_fraction = fraction;
+			}
+			else
+			{
+				stack[stack_size++] = node.child1;
+				stack[stack_size++] = node.child2;
+			}
+		}
+	}
+};
@@ -0,0 +1,99 @@
+/**
+@file
+@brief implementation of accounting of heap allocations
+@author Sergei Kachkov
+*/
+#include <string.h>
+#include <atomic>
+#include "allocation.h"
+
+const size_t AllocationTracker::max_phases;
+
+/// counters are plain atomics, so they work before static constructors and never allocate
+struct PhaseSlot
+{
+	std::atomic<const char *> phase;
+	std::atomic<size_t> allocations;
+	std::atomic<size_t> bytes;
+};
+
+static PhaseSlot slots[AllocationTracker::max_phases];
+static std::atomic<bool> tracking (false);
+static std::atomic<bool> installed (false);
+static thread_local const char *current_phase = NULL;
+
+void AllocationTracker::Enable (bool enabled)
+{
+	tracking.store (enabled);
+}
+
+bool AllocationTracker::Enabled ()
+{
+	return tracking.load ();
+}
+
+void AllocationTracker::Install ()
+{
+	installed.store (true);
+}
+
+bool AllocationTracker::Installed ()
+{
+	return installed.load ();
+}
+
+const char *AllocationTracker::SetPhase (const char *phase)
+{
+	const char *previous = current_phase;
+	current_phase = phase;
+	return previous;
+}
+
+void AllocationTracker::Count (size_t bytes)
+{
+	if (!current_phase || !tracking.load (std::memory_order_relaxed))
+		return;
+	//slot of phase is taken by the first allocation of phase; names are compared by pointers
+	size_t i = 0;
+	for (; i + 1 < max_phases; i++)
+	{
+		const char *phase = slots[i].phase.load (std::memory_order_acquire);
+		if (phase == current_phase)
+			break;
+		if (!phase && (slots[i].phase.compare_exchange_strong (phase, current_phase) || phase == current_phase))
+			break;
+	}
+	slots[i].allocations.fetch_add (1, std::memory_order_relaxed);
+	slots[i].bytes.fetch_add (bytes, std::memory_order_relaxed);
+}
+
+void AllocationTracker::Collect (std::vector<AllocationCounter> *counters)
+{
+	counters->clear ();
+	for (size_t i = 0; i < max_phases; i++)
+	{
+		AllocationCounter counter = {slots[i].phase.load (), slots[i].allocations.load (), slots[i].bytes.load ()};
+		if (!counter.phase || !counter.allocations)
+			continue;
+		//equal string literals of different files can have different addresses
+		size_t k = 0;
+		while (k < counters->size () && strcmp ((*counters)[k].phase, counter.phase))
+			k++;
+		if (k < counters->size ())
+		{
+			(*counters)[k].allocations += counter.allocations;
+			(*counters)[k].bytes += counter.bytes;
+		}
+		else
+			counters->push_back (counter);
+	}
+}
+
+void AllocationTracker::Reset ()
+{
+	for (size_t i = 0; i < max_phases; i++)
+	{
+		slots[i].allocations.store (0);
+		slots[i].bytes.store (0);
+	}
+}
@@ -0,0 +1,91 @@
+/**
+@file
+@brief accounting of heap allocations of engine
+@author Sergei Kachkov
+*/
+#pragma once
+#include <stddef.h>
+#include <vector>
+
+/**
+@class
+@brief number and size of heap allocations made in one phase
+*/
+struct AllocationCounter
+{
+	const char *phase;
+	size_t allocations;
+	size_t bytes;
+};
+
+/**
+@class
+@brief counts heap allocations by phases of engine (tasks of update, creation of bodies of every type)
+@note allocations reach tracker only in programs linked with allocation_hooks.cpp that replaces global operator new;
+allocation is counted only if tracking is enabled and phase of calling thread is set, so allocations of application
+outside of engine are not counted
+*/
+class AllocationTracker
+{
+public:
+	/**
+	@brief enables or disables counting; it's disabled by default
+	*/
+	static void Enable (bool enabled);
+	/**
+	@return true, if counting is enabled
+	*/
+	static bool Enabled ();
+	/**
+	@brief marks that global operator new counts allocations; it's called by allocation_hooks.cpp
+	*/
+	static void Install ();
+	/**
+	@return true, if program is linked with replacement of global operator new
+	*/
+	static bool Installed ();
+	/**
+	@brief sets phase of allocations of calling thread
+	@param phase name of phase; must be static string; NULL - allocations are not counted
+	@return previous phase of thread
+	*/
+	static const char *SetPhase (const char *phase);
+	/**
+	@brief counts allocation in phase of calling thread
+	@param bytes size of allocated block
+	*/
+	static void Count (size_t bytes);
+	/**
+	@brief gives counters of all phases that allocated memory since the last reset
+	@param counters pointer to array of counters; phases with equal names are merged
+	@note array is not reallocated if its capacity is enough, so it can be called in checked phase
+	*/
+	static void Collect (std::vector<AllocationCounter> *counters);
+	/**
+	@brief sets all counters to zero
+	*/
+	static void Reset ();
+	/// maximal number of different phases; allocations of other phases are added to the last one
+	static const size_t max_phases = 64;
+};
+
+/**
+@class
+@brief sets phase of allocations of calling thread till end of scope
+*/
+class AllocationPhase
+{
+private:
+	const char *previous;
+	AllocationPhase (const AllocationPhase &);
+	AllocationPhase &operator= (const AllocationPhase &);
+public:
+	AllocationPhase (const char *phase) :
+		previous (AllocationTracker::SetPhase (phase))
+	{ }
+
+	~AllocationPhase ()
+	{
+		AllocationTracker::SetPhase (previous);
+	}
+};
@@ -0,0 +1,75 @@
+/**
+@file
+@brief replacement of global allocation functions that counts allocations in AllocationTracker
+@author Sergei Kachkov
+@note it is linked only into programs that check allocations; other programs keep allocator of runtime
+*/
+#include <stdlib.h>
+#include <new>
+#include "allocation.h"
+
+/// tracker knows that allocations reach it
+static struct Installer
+{
+	Installer ()
+	{
+		AllocationTracker::Install ();
+	}
+} installer;
+
+//----------replacement of global allocation functions------
+void *operator new (size_t bytes)
+{
+	AllocationTracker::Count (bytes);
+	void *block = malloc (bytes ? bytes : 1);
+	if (!block)
+		throw std::bad_alloc ();
+	return block;
+}
+
+void *operator new[] (size_t bytes)
+{
+	return ::operator new (bytes);
+}
+
+void *operator new (size_t bytes, const std::nothrow_t &) noexcept
+{
+	AllocationTracker::Count (bytes);
+	return malloc (bytes ? bytes : 1);
+}
+
+void *operator new[] (size_t bytes, const std::nothrow_t &tag) noexcept
+{
+	return ::operator new (bytes, tag);
+}
+
+void operator delete (void *block) noexcept
+{
+	free (block);
+}
+
+void operator delete[] (void *block) noexcept
+{
+	free (block);
+}
+
+void operator delete (void *block, size_t) noexcept
+{
+	free (block);
+}
+
+void operator delete[] (void *block, size_t) noexcept
+{
+	free (block);
+}
+
+void operator delete (void *block, const std::nothrow_t &) noexcept
+{
+	free (block);
+}
+
+void operator delete[] (void *block, const std::nothrow_t &) noexcept
+{
+	free (block);
+}
+//----------end of replacement of global allocation functions
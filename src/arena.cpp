@@ -0,0 +1,94 @@
+/**
+@file
+@brief implementation of pooled memory
+@author Sergei Kachkov
+*/
+#include <new>
+#include "arena.h"
+
+Arena::Arena () :
+	chunk_cur (NULL),
+	chunk_left (0),
+	used (0),
+	reserved (0)
+{
+	for (size_t i = 0; i < classes; i++)
+		free_lists[i] = NULL;
+}
+
+Arena::~Arena ()
+{
+	for (size_t i = 0; i < chunks.size (); i++)
+		::operator delete (chunks[i]);
+}
+
+size_t Arena::Class (size_t bytes)
+{
+	size_t k = 0;
+	while (k < classes && (min_block << k) < bytes)
+		k++;
+	return k;
+}
+
+void Arena::ReleaseTail ()
+{
+	//the biggest blocks that fit are cut first; chunk_left is always multiple of min_block
+	for (size_t k = classes; k-- > 0;)
+		while (chunk_left >= (min_block << k))
+		{
+			FreeBlock *block = (FreeBlock *)chunk_cur;
+			block->next = free_lists[k];
+			free_lists[k] = block;
+			chunk_cur += min_block << k;
+			chunk_left -= min_block << k;
+		}
+}
+
+void *Arena::Allocate (size_t bytes)
+{
+	size_t k = Class (bytes);
+	if (k == classes)
+	{
+		used += bytes;
+		reserved += bytes;
+		return ::operator new (bytes);
+	}
+	size_t size = min_block << k;
+	used += size;
+	if (free_lists[k])
+	{
+		FreeBlock *block = free_lists[k];
+		free_lists[k] = block->next;
+		return block;
+	}
+	if (chunk_left < size)
+	{
+		ReleaseTail ();
+		chunks.push_back ((char *)::operator new (chunk_size));
+		chunk_cur = chunks.back ();
+		reserved += chunk_size;
+		chunk_left = chunk_size;
+	}
+	void *block = chunk_cur;
+	chunk_cur += size;
+	chunk_left -= size;
+	return block;
+}
+
+void Arena::Free (void *block, size_t bytes)
+{
+	if (!block)
+		return;
+	size_t k = Class (bytes);
+	if (k == classes)
+	{
+		used -= bytes;
+		reserved -= bytes;
+		::operator delete (block);
+		return;
+	}
+	used -= min_block << k;
+	FreeBlock *free_block = (FreeBlock *)block;
+	free_block->next = free_lists[k];
+	free_lists[k] = free_block;
+}
@@ -0,0 +1,121 @@
+/**
+@file
+@brief pooled memory for bodies
+@author Sergei Kachkov
+*/
+#pragma once
+#include <stddef.h>
+#include <vector>
+#include <type_traits>
+
+/**
+@class
+@brief allocator of memory blocks of power-of-two size classes
+@note blocks are cut from big chunks and returned to free list of their class;
+memory goes back to system only when arena is destroyed
+@warning arena is not thread-safe; every world owns its arena
+*/
+class Arena
+{
+private:
+	struct FreeBlock
+	{
+		FreeBlock *next;
+	};
+	static const size_t min_block = 16;
+	static const size_t classes = 13;
+	static const size_t chunk_size = 1 << 16;
+	FreeBlock *free_lists[classes];
+	std::vector<char *> chunks;
+	char *chunk_cur;
+	size_t chunk_left;
+	/// bytes of blocks given out and bytes taken from heap
+	size_t used, reserved;
+	/**
+	@return size class of block; classes for blocks that are too big
+	*/
+	static size_t Class (size_t bytes);
+	/**
+	@brief puts unused end of current chunk to free lists
+	*/
+	void ReleaseTail ();
+	Arena (const Arena &);
+	Arena &operator= (const Arena &);
+public:
+	Arena ();
+	~Arena ();
+	/**
+	@brief allocates block
+	@param bytes size of block; blocks bigger than the biggest class are taken from heap
+	*/
+	void *Allocate (size_t bytes);
+	/**
+	@brief returns block to arena
+	@param block pointer to block
+	@param bytes size of block passed to Allocate
+	*/
+	void Free (void *block, size_t bytes);
+	/**
+	@return bytes of blocks in use rounded up to their size classes
+	*/
+	size_t Used ()
+	{
+		return used;
+	}
+	/**
+	@return bytes taken from heap: chunks and big blocks
+	*/
+	size_t Reserved ()
+	{
+		return reserved;
+	}
+};
+
+/**
+@class
+@brief STL allocator that takes memory from arena
+*/
+template <class T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+	typedef std::true_type propagate_on_container_copy_assignment;
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+	Arena *arena;
+
+	ArenaAllocator (Arena *source) :
+		arena (source)
+	{ }
+
+	template <class U>
+	ArenaAllocator (const ArenaAllocator<U> &b) :
+		arena (b.arena)
+	{ }
+
+	T *allocate (size_t n)
+	{
+		return (T *)arena->Allocate (n * sizeof (T));
+	}
+
+	void deallocate (T *p, size_t n)
+	{
+		arena->Free (p, n * sizeof (T));
+	}
+
+	template <class U>
+	bool operator== (const ArenaAllocator<U> &b) const
+	{
+		return arena == b.arena;
+	}
+
+	template <class U>
+	bool operator!= (const ArenaAllocator<U> &b) const
+	{
+		return arena != b.arena;
+	}
+};
+
+template <class T>
+using ArenaVector = std::vector<T, ArenaAllocator<T> >;
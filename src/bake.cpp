@@ -0,0 +1,327 @@
+/**
+@file
+@brief implementation of baking of static geometry
+@author Sergei Kachkov
+*/
+#include <map>
+#include <algorithm>
+#include "bake.h"
+#include "log.h"
+
+/// sine of angle between edges, below which vertex is collinear
+static const double bake_epsilon = 1e-9;
+
+/**
+@return sine of turn at vertex b of path a-b-c; positive for left turn
+*/
+static double turn (vector2d a, vector2d b, vector2d c)
+{
+	vector2d e1 = b - a, e2 = c - b;
+	double lengths = e1.len () * e2.len ();
+	return lengths > 0.0 ? (e1 * e2) / lengths : 0.0;
+}
+
+/**
+@return true, if vertex b of counter-clockwise polygon is convex or lies on straight edge; spikes are not convex
+*/
+static bool is_convex_vertex (vector2d a, vector2d b, vector2d c)
+{
+	double sine = turn (a, b, c);
+	if (sine > bake_epsilon)
+		return true;
+	if (sine < -bake_epsilon)
+		return false;
+	return ((b - a) ^ (c - b)) > 0.0;
+}
+
+static bool same (vector2d a, vector2d b)
+{
+	return a.x == b.x && a.y == b.y;
+}
+
+static double signed_area (const std::vector<vector2d> &polygon)
+{
+	double area = 0.0;
+	for (size_t i = 0; i < polygon.size (); i++)
+		area += vector2d (polygon[i]) * polygon[(i + 1) % polygon.size ()];
+	return area * 0.5;
+}
+
+/**
+@brief removes repeated vertexes, vertexes on straight edges and spikes
+*/
+static void remove_collinear (std::vector<vector2d> *polygon)
+{
+	std::vector<vector2d> &p = *polygon;
+	bool removed = true;
+	while (removed && p.size () >= 3)
+	{
+		removed = false;
+		for (size_t i = 0; i < p.size () && p.size () >= 3; i++)
+		{
+			vector2d prev = p[(i + p.size () - 1) % p.size ()], next = p[(i + 1) % p.size ()];
+			if (same (p[i], next) || fabs (turn (prev, p[i], next)) < bake_epsilon)
+			{
+				p.erase (p.begin () + i);
+				removed = true;
+				i--;
+			}
+		}
+	}
+	if (p.size () < 3)
+		p.clear ();
+}
+
+/**
+@return true, if segments a-b and c-d have common point
+*/
+static bool segments_touch (vector2d a, vector2d b, vector2d c, vector2d d)
+{
+	double side[4] = {(b - a) * (c - a), (b - a) * (d - a), (d - c) * (a - c), (d - c) * (b - c)};
+	if (((side[0] < 0.0 && side[1] > 0.0) || (side[0] > 0.0 && side[1] < 0.0)) &&
+		((side[2] < 0.0 && side[3] > 0.0) || (side[2] > 0.0 && side[3] < 0.0)))
+		return true;
+	//collinear end lies on other segment
+	vector2d ends[4] = {c, d, a, b}, starts[4] = {a, a, c, c}, finishes[4] = {b, b, d, d};
+	for (int i = 0; i < 4; i++)
+		if (side[i] == 0.0 &&
+			std::min (starts[i].x, finishes[i].x) <= ends[i].x && ends[i].x <= std::max (starts[i].x, finishes[i].x) &&
+			std::min (starts[i].y, finishes[i].y) <= ends[i].y && ends[i].y <= std::max (starts[i].y, finishes[i].y))
+			return true;
+	return false;
+}
+
+static bool is_simple (const std::vector<vector2d> &polygon)
+{
+	size_t n = polygon.size ();
+	for (size_t i = 0; i < n; i++)
+		for (size_t k = i + 2; k < n; k++)
+		{
+			//edges with common vertex
+			if (i == 0 && k == n - 1)
+				continue;
+			if (segments_touch (polygon[i], polygon[i + 1], polygon[k], polygon[(k + 1) % n]))
+				return false;
+		}
+	return true;
+}
+
+static bool is_convex (const std::vector<vector2d> &polygon)
+{
+	size_t n = polygon.size ();
+	for (size_t i = 0; i < n; i++)
+		if (!is_convex_vertex (polygon[(i + n - 1) % n], polygon[i], polygon[(i + 1) % n]))
+			return false;
+	return true;
+}
+
+static bool vector_less (vector2d a, vector2d b)
+{
+	return a.x < b.x || (a.x == b.x && a.y < b.y);
+}
+
+/**
+@brief monotone chain; hull is counter-clockwise
+*/
+static std::vector<vector2d> convex_hull (std::vector<vector2d> points)
+{
+	std::sort (points.begin (), points.end (), vector_less);
+	std::vector<vector2d> hull;
+	for (size_t pass = 0; pass < 2; pass++)
+	{
+		size_t chain_start = hull.size ();
+		for (size_t k = 0; k < points.size (); k++)
+		{
+			vector2d p = points[pass ? points.size () - 1 - k : k];
+			while (hull.size () >= chain_start + 2 &&
+				   ((hull[hull.size () - 1] - hull[hull.size () - 2]) * (p - hull[hull.size () - 2])) < DBL_EPSILON)
+				hull.pop_back ();
+			hull.push_back (p);
+		}
+		//last point of chain is the first point of the other chain
+		hull.pop_back ();
+	}
+	return hull;
+}
+
+/**
+@return true, if point lies in counter-clockwise triangle or on its border
+*/
+static bool in_triangle (vector2d a, vector2d b, vector2d c, vector2d p)
+{
+	return (b - a) * (p - a) >= 0.0 && (c - b) * (p - b) >= 0.0 && (a - c) * (p - c) >= 0.0;
+}
+
+bool triangulate_polygon (const std::vector<vector2d> &polygon, std::vector<std::vector<vector2d> > *triangles)
+{
+	std::vector<size_t> rest (polygon.size ());
+	for (size_t i = 0; i < rest.size (); i++)
+		rest[i] = i;
+	//search continues from the last ear, so triangles don't fan out of one vertex
+	size_t i = 0;
+	while (rest.size () > 3)
+	{
+		size_t count = rest.size (), tries;
+		for (tries = 0; tries < count; tries++, i = (i + 1) % count)
+		{
+			size_t prev = (i + count - 1) % count, next = (i + 1) % count;
+			vector2d a = polygon[rest[prev]], b = polygon[rest[i]], c = polygon[rest[next]];
+			if (turn (a, b, c) <= bake_epsilon)
+				continue;
+			//only vertexes that are not convex can lie in ear
+			bool ear = true;
+			for (size_t k = 0; k < count && ear; k++)
+			{
+				vector2d p = polygon[rest[k]];
+				if (k == prev || k == i || k == next || same (p, a) || same (p, b) || same (p, c) ||
+					turn (polygon[rest[(k + count - 1) % count]], p, polygon[rest[(k + 1) % count]]) > bake_epsilon)
+					continue;
+				ear = !in_triangle (a, b, c, p);
+			}
+			if (ear)
+				break;
+		}
+		if (tries == count)
+			return false;
+		std::vector<vector2d> triangle (3);
+		triangle[0] = polygon[rest[(i + count - 1) % count]];
+		triangle[1] = polygon[rest[i]];
+		triangle[2] = polygon[rest[(i + 1) % count]];
+		triangles->push_back (triangle);
+		rest.erase (rest.begin () + i);
+		i %= rest.size ();
+	}
+	std::vector<vector2d> triangle (3);
+	for (size_t k = 0; k < 3; k++)
+		triangle[k] = polygon[rest[k]];
+	triangles->push_back (triangle);
+	return true;
+}
+
+typedef std::pair<std::pair<double, double>, std::pair<double, double> > EdgeKey;
+
+static EdgeKey edge_key (vector2d from, vector2d to)
+{
+	return EdgeKey (std::make_pair (from.x, from.y), std::make_pair (to.x, to.y));
+}
+
+/**
+@brief joins piece b to piece a through edge a[edge]-a[edge + 1] that is reversed edge of b
+@param joined pointer to joined piece; it is filled only if it is convex
+@return true, if joined piece is convex
+*/
+static bool join_pieces (const std::vector<vector2d> &a, size_t edge, const std::vector<vector2d> &b,
+						 std::vector<vector2d> *joined)
+{
+	size_t na = a.size (), nb = b.size ();
+	vector2d u = a[edge], v = a[(edge + 1) % na];
+	size_t m;
+	for (m = 0; m < nb; m++)
+		if (same (b[m], v) && same (b[(m + 1) % nb], u))
+			break;
+	if (m == nb)
+		return false;
+	//joined piece is a from v to u followed by b from vertex after u to vertex before v
+	if (!is_convex_vertex (a[(edge + na - 1) % na], u, b[(m + 2) % nb]) ||
+		!is_convex_vertex (b[(m + nb - 1) % nb], v, a[(edge + 2) % na]))
+		return false;
+	joined->clear ();
+	for (size_t k = 0; k < na; k++)
+		joined->push_back (a[(edge + 1 + k) % na]);
+	for (size_t k = 2; k < nb; k++)
+		joined->push_back (b[(m + k) % nb]);
+	return true;
+}
+
+void merge_pieces (std::vector<std::vector<vector2d> > *pieces)
+{
+	std::vector<std::vector<vector2d> > &p = *pieces;
+	//piece by its directed edge
+	std::map<EdgeKey, size_t> edges;
+	for (size_t i = 0; i < p.size (); i++)
+		for (size_t j = 0; j < p[i].size (); j++)
+			edges[edge_key (p[i][j], p[i][(j + 1) % p[i].size ()])] = i;
+
+	std::vector<bool> alive (p.size (), true);
+	std::vector<vector2d> joined;
+	for (size_t i = 0; i < p.size (); i++)
+	{
+		if (!alive[i])
+			continue;
+		//every merge changes piece, so its edges are checked again
+		bool merged = true;
+		while (merged)
+		{
+			merged = false;
+			for (size_t j = 0; j < p[i].size () && !merged; j++)
+			{
+				vector2d u = p[i][j], v = p[i][(j + 1) % p[i].size ()];
+				std::map<EdgeKey, size_t>::iterator other = edges.find (edge_key (v, u));
+				if (other == edges.end () || other->second == i || !alive[other->second] ||
+					!join_pieces (p[i], j, p[other->second], &joined))
+					continue;
+				size_t k = other->second;
+				edges.erase (other);
+				edges.erase (edge_key (u, v));
+				for (size_t e = 0; e < p[k].size (); e++)
+				{
+					std::map<EdgeKey, size_t>::iterator edge = edges.find (edge_key (p[k][e], p[k][(e + 1) % p[k].size ()]));
+					if (edge != edges.end () && edge->second == k)
+						edge->second = i;
+				}
+				p[i].swap (joined);
+				p[k].clear ();
+				alive[k] = false;
+				merged = true;
+			}
+		}
+	}
+
+	//vertexes on straight edges are kept till the end, because neighbors may share edges through them
+	size_t kept = 0;
+	for (size_t i = 0; i < p.size (); i++)
+	{
+		if (!alive[i])
+			continue;
+		remove_collinear (&p[i]);
+		if (!p[i].empty ())
+			p[kept++].swap (p[i]);
+	}
+	p.resize (kept);
+}
+
+void bake_polygons (const std::vector<std::vector<vector2d> > &polygons, std::vector<std::vector<vector2d> > *pieces)
+{
+	std::vector<std::vector<vector2d> > baked;
+	for (size_t i = 0; i < polygons.size (); i++)
+	{
+		std::vector<vector2d> polygon = polygons[i];
+		remove_collinear (&polygon);
+		if (polygon.empty ())
+		{
+			log (LOG_INFO, "polygon %u has no area and is skipped", i);
+			continue;
+		}
+		if (signed_area (polygon) < 0.0)
+			std::reverse (polygon.begin (), polygon.end ());
+		if (is_simple (polygon))
+		{
+			if (is_convex (polygon))
+			{
+				baked.push_back (polygon);
+				continue;
+			}
+			size_t triangles = baked.size ();
+			if (triangulate_polygon (polygon, &baked))
+				continue;
+			baked.resize (triangles);
+		}
+		//points without order of simple polygon are taken as set, like vertexes of convex body
+		log (LOG_INFO, "polygon %u is not simple, its convex hull is used", i);
+		baked.push_back (convex_hull (polygon));
+	}
+	size_t count = baked.size ();
+	merge_pieces (&baked);
+	log (LOG_INFO, "%u polygons are baked to %u convex pieces from %u", polygons.size (), baked.size (), count);
+	pieces->insert (pieces->end (), baked.begin (), baked.end ());
+}
@@ -0,0 +1,31 @@
+/**
+@file
+@brief baking of static geometry: decomposition of polygons to convex pieces and merging of adjacent pieces
+@author Sergei Kachkov
+*/
+#pragma once
+#include <vector>
+#include "vector.h"
+
+/**
+@brief splits simple polygon to triangles by ear clipping
+@param polygon counter-clockwise simple polygon without collinear vertexes
+@param triangles pointer to array where counter-clockwise triangles are added
+@return false, if ear is not found (polygon is not simple)
+*/
+bool triangulate_polygon (const std::vector<vector2d> &polygon, std::vector<std::vector<vector2d> > *triangles);
+
+/**
+@brief merges pieces that share whole edge while their union stays convex; collinear vertexes are removed after merging
+@param pieces pointer to array of counter-clockwise convex pieces
+@note merging of triangles of polygon is Hertel-Mehlhorn algorithm, so number of pieces is at most 4 times more than
+minimal number; pieces of different polygons are merged the same way
+*/
+void merge_pieces (std::vector<std::vector<vector2d> > *pieces);
+
+/**
+@brief decomposes polygons to near minimal set of convex pieces
+@param polygons simple polygons in any order of vertexes; polygon that is not simple is replaced with its convex hull
+@param pieces pointer to array where counter-clockwise convex pieces are added
+*/
+void bake_polygons (const std::vector<std::vector<vector2d> > &polygons, std::vector<std::vector<vector2d> > *pieces);
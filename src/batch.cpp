@@ -0,0 +1,38 @@
+/**
+@file
+@brief implementation of simulation of many independent worlds
+@author Sergei Kachkov
+*/
+#include "batch.h"
+#include "log.h"
+
+BatchRunner::BatchRunner (std::shared_ptr<StaticGeometry> statics, unsigned int threads) :
+	pool (threads),
+	statics (statics)
+{
+	log (LOG_INFO, "batch runner started with %u threads", pool.Size ());
+}
+
+Physics &BatchRunner::AddWorld (double timestep, vector2d gravity, BoundingBox world_size)
+{
+	worlds.push_back (std::unique_ptr<Physics> (new Physics (timestep, gravity, world_size, statics)));
+	return *worlds.back ();
+}
+
+void BatchRunner::Run (unsigned int steps, unsigned int iterations, std::function<void (size_t, Physics &)> gather)
+{
+	//tree of shared geometry is completed before worlds read it in parallel
+	statics->UpdateProxies ();
+	for (size_t i = 0; i < worlds.size (); i++)
+	{
+		Physics *world = worlds[i].get ();
+		pool.Submit ([world, i, steps, iterations, &gather] ()
+		{
+			for (unsigned int step = 0; step < steps; step++)
+				world->Update (iterations);
+			if (gather)
+				gather (i, *world);
+		});
+	}
+	pool.Wait ();
+}
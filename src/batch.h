@@ -0,0 +1,61 @@
+/**
+@file
+@brief simulation of many independent worlds
+@author Sergei Kachkov
+*/
+#pragma once
+#include <vector>
+#include <memory>
+#include <functional>
+#include "physics.h"
+#include "threadpool.h"
+
+/**
+@class
+@brief steps batch of independent worlds in parallel; worlds share static geometry
+@note every world is stepped by one task, so worlds of different size are balanced by work stealing
+*/
+class BatchRunner
+{
+private:
+	ThreadPool pool;
+	std::shared_ptr<StaticGeometry> statics;
+	std::vector<std::unique_ptr<Physics> > worlds;
+public:
+	/**
+	@brief creates runner
+	@param statics static geometry of all worlds; it is read-only while batch runs
+	@param threads number of threads; 0 - number of hardware threads
+	*/
+	BatchRunner (std::shared_ptr<StaticGeometry> statics, unsigned int threads);
+	/**
+	@brief creates world with shared static geometry
+	@param timestep step of simulation
+	@param gravity vector of gravity
+	@param world_size bounding box of world
+	@return created world; dynamic bodies and particles should be added to it directly
+	*/
+	Physics &AddWorld (double timestep, vector2d gravity, BoundingBox world_size);
+	/**
+	@return number of worlds
+	*/
+	size_t Size ()
+	{
+		return worlds.size ();
+	}
+	/**
+	@return world by its index
+	*/
+	Physics &GetWorld (size_t world)
+	{
+		return *worlds[world];
+	}
+	/**
+	@brief updates all worlds
+	@param steps number of steps of every world
+	@param iterations number of resolve iterations
+	@param gather function (index of world, world) that is called in thread of world after its last step;
+	it should write result of world to its own place; can be empty
+	*/
+	void Run (unsigned int steps, unsigned int iterations, std::function<void (size_t, Physics &)> gather);
+};
@@ -48,6 +48,32 @@ struct BoundingBox
 		#endif // DEBUG
 	}
 
+	/**
+	@brief check that point lies inside of box
+	@param point coordinates of point
+	@return true, if point is inside or on the border
+	*/
+	bool Contains (vector2d point)
+	{
+		return point.x >= lb.x && point.x <= rt.x && point.y >= lb.y && point.y <= rt.y;
+	}
+
+	/**
+	@brief grows box to contain point
+	@param point coordinates of point
+	*/
+	void Expand (vector2d point)
+	{
+		if (point.x < lb.x)
+			lb.x = point.x;
+		if (point.x > rt.x)
+			rt.x = point.x;
+		if (point.y < lb.y)
+			lb.y = point.y;
+		if (point.y > rt.y)
+			rt.y = point.y;
+	}
+
 	/**
 	@brief check intersection of two boxes
 	@return true, if bounding boxes intersects
@@ -0,0 +1,74 @@
+/**
+@file
+@brief check that result of update doesn't depend on number of threads
+@author Sergei Kachkov
+@note usage: physics_determinism [steps]; the same scene is simulated with 1, 4 and 16 threads and hashes of
+state are compared; exit code is not zero if they differ
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "physics.h"
+
+static const double timestep = 0.002;
+static const unsigned int iterations = 8;
+
+/**
+@brief fills world with all kinds of bodies; piles are big enough to be split to many chunks
+*/
+static void build_scene (Physics *world)
+{
+	world->AddStaticBody (4, vector2d (-30, -1), vector2d (30, -1), vector2d (30, 0), vector2d (-30, 0));
+	std::vector<double> heights;
+	for (int i = 0; i < 50; i++)
+		heights.push_back (0.3 * sin (i * 0.7));
+	world->AddTerrain (30.0, 0.5, heights);
+	for (int i = 0; i < 20; i++)
+		for (int j = 0; j < 30; j++)
+		{
+			vector2d corner (-15 + j * 0.9, 0.5 + i * 0.9);
+			size_t body = world->AddDynamicBody (0.1, 4, Point (corner, 1.0), Point (corner + vector2d (0.5, 0), 1.0),
+												 Point (corner + vector2d (0.5, 0.5), 1.0), Point (corner + vector2d (0, 0.5), 1.0));
+			if (j % 3 == 0)
+				world->DynamicBodies[body].compliance = 0.0001;
+		}
+	for (int i = 0; i < 400; i++)
+		world->AddParticle (vector2d (-20 + (i % 20) * 0.06, 3 + (i / 20) * 0.06), 0.025, 0.1);
+	world->AddLatticeBody (6, 4, vector2d (16, 2), 0.2, 1.0, 0.05);
+	world->AddRope (vector2d (20, 4), vector2d (24, 4), 20, 1.0, 0.03);
+	world->SetReordering (50);
+	world->SetConstraintSolver (2, 2);
+	world->SetRegionOfInterest (BoundingBox (vector2d (-5, -5), vector2d (5, 5)), 3.0, 2);
+}
+
+int main (int argc, char *argv[])
+{
+	int steps = argc > 1 ? atoi (argv[1]) : 300;
+	if (steps < 0)
+	{
+		printf ("usage: %s [steps]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	InitLog ();
+	const unsigned int threads[] = {1, 4, 16};
+	unsigned long long hashes[3];
+	for (int k = 0; k < 3; k++)
+	{
+		Physics world (timestep, vector2d (0, -10), BoundingBox (vector2d (-100, -100), vector2d (100, 100)));
+		build_scene (&world);
+		world.SetThreads (threads[k]);
+		for (int i = 0; i < steps; i++)
+			world.Update (iterations);
+		hashes[k] = world.StateHash ();
+		printf ("%2u threads: hash %016llx, %u bodies\n", threads[k], hashes[k], (unsigned int)world.DynamicBodies.size ());
+	}
+	CloseLog ();
+	if (hashes[1] != hashes[0] || hashes[2] != hashes[0])
+	{
+		printf ("state depends on number of threads\n");
+		return EXIT_FAILURE;
+	}
+	printf ("state is the same for all numbers of threads\n");
+	return 0;
+}
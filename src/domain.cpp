@@ -0,0 +1,289 @@
+/**
+@file
+@brief implementation of spatial decomposition of world between processes
+@author Sergei Kachkov
+*/
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <type_traits>
+#include "domain.h"
+
+//----------encoding of bodies------------------------------
+template <class T>
+static void put (std::string *out, const T &value)
+{
+	out->append ((const char *)&value, sizeof (T));
+}
+
+/**
+@note points and poles have no default constructors, so value is copied through raw storage
+*/
+template <class T>
+static T get (const std::string &in, size_t *pos)
+{
+	typename std::aligned_storage<sizeof (T), alignof (T)>::type value;
+	memcpy (&value, in.data () + *pos, sizeof (T));
+	*pos += sizeof (T);
+	return *(T *)&value;
+}
+
+template <class Vector>
+static void put_array (std::string *out, const Vector &array)
+{
+	put (out, (size_t)array.size ());
+	if (!array.empty ())
+		out->append ((const char *)&array[0], array.size () * sizeof (array[0]));
+}
+
+template <class Vector>
+static void get_array (const std::string &in, size_t *pos, Vector *array)
+{
+	size_t size = get<size_t> (in, pos);
+	array->clear ();
+	for (size_t i = 0; i < size; i++)
+		array->push_back (get<typename Vector::value_type> (in, pos));
+}
+//----------end of encoding of bodies-----------------------
+
+//----------implementation of subdomain---------------------
+Subdomain::Subdomain (double timestep, vector2d gravity, BoundingBox world_size, double x1, double x2, double ghost_width) :
+	x_min (x1),
+	x_max (x2),
+	ghost_width (ghost_width),
+	step_index (0),
+	world (timestep, gravity, world_size)
+{
+	neighbors[0] = neighbors[1] = -1;
+}
+
+void Subdomain::Connect (int left, int right)
+{
+	neighbors[0] = left;
+	neighbors[1] = right;
+}
+
+bool Subdomain::AddBody (size_t id, double stiffness, const std::vector<Point> &points)
+{
+	double left = DBL_MAX, right = -DBL_MAX;
+	for (size_t i = 0; i < points.size (); i++)
+	{
+		left = std::min (left, points[i].cur_pos.x);
+		right = std::max (right, points[i].cur_pos.x);
+	}
+	double center = (left + right) * 0.5;
+	if ((center < x_min && neighbors[0] >= 0) || (center >= x_max && neighbors[1] >= 0))
+		return false;
+	size_t body = world.AddDynamicBody (stiffness, points);
+	Entry entry = {id, false, 0};
+	entries[world.GetHandle (body)] = entry;
+	handles[id] = world.GetHandle (body);
+	return true;
+}
+
+void Subdomain::Write (std::string *message, size_t id, bool migrate, const DynamicBody &body)
+{
+	put (message, id);
+	put (message, migrate);
+	put (message, body.stiffness);
+	put (message, body.compliance);
+	put (message, (int)body.topology);
+	put (message, body.level);
+	put (message, body.last_timestep);
+	put (message, body.filter);
+	put_array (message, body.points);
+	put_array (message, body.poles);
+	put_array (message, body.edges);
+	put_array (message, body.rest);
+}
+
+void Subdomain::Exchange ()
+{
+	//message is its size followed by bodies; size of input is known after its first bytes
+	size_t sent[2] = {0, 0}, expected[2];
+	for (int side = 0; side < 2; side++)
+	{
+		size_t size = output[side].size ();
+		output[side].insert (0, (const char *)&size, sizeof (size_t));
+		input[side].clear ();
+		expected[side] = sizeof (size_t);
+	}
+	while (true)
+	{
+		pollfd sockets[2];
+		int sides[2];
+		nfds_t sockets_num = 0;
+		for (int side = 0; side < 2; side++)
+		{
+			if (neighbors[side] < 0)
+				continue;
+			if (expected[side] == sizeof (size_t) && input[side].size () == sizeof (size_t))
+			{
+				size_t pos = 0;
+				expected[side] += get<size_t> (input[side], &pos);
+			}
+			short events = (sent[side] < output[side].size () ? POLLOUT : 0) | (input[side].size () < expected[side] ? POLLIN : 0);
+			if (!events)
+				continue;
+			sockets[sockets_num].fd = neighbors[side];
+			sockets[sockets_num].events = events;
+			sides[sockets_num++] = side;
+		}
+		if (!sockets_num)
+			break;
+		if (poll (sockets, sockets_num, -1) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			log (LOG_FAIL, "poll of sockets of neighbors failed");
+		}
+		for (nfds_t i = 0; i < sockets_num; i++)
+		{
+			int side = sides[i];
+			if (sockets[i].revents & POLLOUT)
+			{
+				ssize_t bytes = send (neighbors[side], output[side].data () + sent[side], output[side].size () - sent[side],
+									  MSG_NOSIGNAL | MSG_DONTWAIT);
+				if (bytes > 0)
+					sent[side] += bytes;
+				else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+					log (LOG_FAIL, "neighbor of subdomain closed connection");
+			}
+			if (sockets[i].revents & (POLLIN | POLLHUP | POLLERR))
+			{
+				char buffer[65536];
+				size_t wanted = std::min (sizeof (buffer), expected[side] - input[side].size ());
+				ssize_t bytes = recv (neighbors[side], buffer, wanted, MSG_DONTWAIT);
+				if (bytes > 0)
+					input[side].append (buffer, bytes);
+				else if (bytes == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+					log (LOG_FAIL, "neighbor of subdomain closed connection");
+			}
+		}
+	}
+	for (int side = 0; side < 2; side++)
+	{
+		output[side].clear ();
+		if (neighbors[side] >= 0)
+			input[side].erase (0, sizeof (size_t));
+	}
+}
+
+void Subdomain::Read (const std::string &message)
+{
+	size_t pos = 0;
+	DynamicBody body (0.0, &arena);
+	while (pos < message.size ())
+	{
+		size_t id = get<size_t> (message, &pos);
+		bool migrate = get<bool> (message, &pos);
+		body.stiffness = get<double> (message, &pos);
+		body.compliance = get<double> (message, &pos);
+		body.topology = (Topology)get<int> (message, &pos);
+		body.level = get<unsigned int> (message, &pos);
+		body.last_timestep = get<double> (message, &pos);
+		body.filter = get<CollisionFilter> (message, &pos);
+		get_array (message, &pos, &body.points);
+		get_array (message, &pos, &body.poles);
+		get_array (message, &pos, &body.edges);
+		get_array (message, &pos, &body.rest);
+		body.mass = 0.0;
+		for (size_t i = 0; i < body.points.size (); i++)
+			body.mass += body.points[i].m;
+
+		//ghost of the previous step is updated in place, so its contacts stay in cache
+		size_t index;
+		std::unordered_map<size_t, size_t>::iterator handle = handles.find (id);
+		bool exists = handle != handles.end () && world.FindBody (handle->second, &index);
+		if (exists && world.DynamicBodies[index].points.size () == body.points.size ())
+		{
+			DynamicBody &local = world.DynamicBodies[index];
+			std::copy (body.points.begin (), body.points.end (), local.points.begin ());
+			local.level = body.level;
+			local.last_timestep = body.last_timestep;
+			local.filter = body.filter;
+			local.RecalculateBBox ();
+		}
+		else
+		{
+			if (exists)
+			{
+				entries.erase (handle->second);
+				world.DestroyDynamicBody (index);
+			}
+			index = world.AddDynamicBody (body);
+			handles[id] = world.GetHandle (index);
+		}
+		Entry entry = {id, !migrate, step_index};
+		entries[world.GetHandle (index)] = entry;
+	}
+}
+
+void Subdomain::Step (unsigned int iterations)
+{
+	step_index++;
+	for (size_t i = 0; i < world.DynamicBodies.size (); i++)
+	{
+		DynamicBody &body = world.DynamicBodies[i];
+		Entry &entry = entries[body.handle];
+		if (entry.ghost)
+			continue;
+		double center = (body.bbox.lb.x + body.bbox.rt.x) * 0.5;
+		int side = (center < x_min && neighbors[0] >= 0) ? 0 : (center >= x_max && neighbors[1] >= 0) ? 1 : -1;
+		if (side >= 0)
+		{
+			//neighbor owns body from now; it stays here as ghost till neighbor sends it
+			Write (&output[side], entry.id, true, body);
+			entry.ghost = true;
+			entry.step = step_index;
+			continue;
+		}
+		if (neighbors[0] >= 0 && body.bbox.lb.x < x_min + ghost_width)
+			Write (&output[0], entry.id, false, body);
+		if (neighbors[1] >= 0 && body.bbox.rt.x > x_max - ghost_width)
+			Write (&output[1], entry.id, false, body);
+	}
+	Exchange ();
+	for (int side = 0; side < 2; side++)
+		Read (input[side]);
+
+	//ghosts that are far from border now and bodies that left world are forgotten
+	for (size_t i = world.DynamicBodies.size (); i-- > 0;)
+	{
+		std::unordered_map<size_t, Entry>::iterator entry = entries.find (world.DynamicBodies[i].handle);
+		if (entry->second.ghost && entry->second.step != step_index)
+		{
+			handles.erase (entry->second.id);
+			entries.erase (entry);
+			world.DestroyDynamicBody (i);
+		}
+	}
+	if (entries.size () > world.DynamicBodies.size ())
+		for (std::unordered_map<size_t, Entry>::iterator entry = entries.begin (); entry != entries.end ();)
+		{
+			size_t index;
+			if (world.FindBody (entry->first, &index))
+				++entry;
+			else
+			{
+				handles.erase (entry->second.id);
+				entry = entries.erase (entry);
+			}
+		}
+
+	world.Update (iterations);
+}
+
+void Subdomain::OwnedBodies (std::vector<std::pair<size_t, size_t> > *bodies)
+{
+	bodies->clear ();
+	for (size_t i = 0; i < world.DynamicBodies.size (); i++)
+	{
+		Entry &entry = entries[world.DynamicBodies[i].handle];
+		if (!entry.ghost)
+			bodies->push_back (std::make_pair (entry.id, i));
+	}
+}
+//----------end of implementation of subdomain--------------
@@ -0,0 +1,89 @@
+/**
+@file
+@brief spatial decomposition of world between processes
+@author Sergei Kachkov
+*/
+#pragma once
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include "physics.h"
+
+/**
+@class
+@brief vertical strip of world simulated by one process; neighbor strips are connected by stream sockets
+@note body is owned by strip that contains center of its bounding box. Owned bodies near border are sent to
+neighbor every step and simulated there as ghosts; their state is replaced by state from owner at next step.
+Body whose center leaves strip migrates to neighbor and stays here as ghost.
+*/
+class Subdomain
+{
+private:
+	struct Entry
+	{
+		/// id of body that is the same in all processes
+		size_t id;
+		bool ghost;
+		/// last step when ghost was received or migrated out
+		size_t step;
+	};
+	double x_min, x_max, ghost_width;
+	/// sockets of left and right neighbors; -1 - no neighbor
+	int neighbors[2];
+	size_t step_index;
+	/// bodies by their handles
+	std::unordered_map<size_t, Entry> entries;
+	/// handles of bodies by their ids
+	std::unordered_map<size_t, size_t> handles;
+	std::string output[2], input[2];
+	/// memory of received bodies before they are copied to world
+	Arena arena;
+	/**
+	@brief adds body to message
+	@param migrate true, if ownership of body is passed to neighbor
+	*/
+	void Write (std::string *message, size_t id, bool migrate, const DynamicBody &body);
+	/**
+	@brief sends messages to neighbors and receives their messages at once, so full sockets can't block both sides
+	*/
+	void Exchange ();
+	/**
+	@brief creates, updates or takes ownership of bodies of message
+	*/
+	void Read (const std::string &message);
+	Subdomain (const Subdomain &);
+	Subdomain &operator= (const Subdomain &);
+public:
+	Physics world;
+	/**
+	@brief creates strip; world of strip has the same size as the whole world
+	@param timestep, gravity, world_size parameters of world
+	@param x1, x2 borders of strip; bodies left of the first strip and right of the last one stay in them
+	@param ghost_width distance from border where owned bodies are sent to neighbor; it should be more than
+	size of the biggest body
+	*/
+	Subdomain (double timestep, vector2d gravity, BoundingBox world_size, double x1, double x2, double ghost_width);
+	/**
+	@brief sets sockets of neighbors; subdomain doesn't close them
+	@param left, right connected stream sockets; -1 - no neighbor
+	*/
+	void Connect (int left, int right);
+	/**
+	@brief adds owned body if center of its points lies in strip
+	@param id id of body in all processes
+	@param stiffness stiffness of body
+	@param points mass points of convex hull
+	@return false, if body belongs to other strip
+	*/
+	bool AddBody (size_t id, double stiffness, const std::vector<Point> &points);
+	/**
+	@brief exchanges ghosts and migrating bodies with neighbors and updates world
+	@param iterations number of resolve iterations
+	*/
+	void Step (unsigned int iterations);
+	/**
+	@brief finds owned bodies
+	@param bodies pointer to array of pairs (id, index in DynamicBodies)
+	*/
+	void OwnedBodies (std::vector<std::pair<size_t, size_t> > *bodies);
+};
@@ -0,0 +1,116 @@
+/**
+@file
+@brief implementation of mutual gravity of point masses
+@author Sergei Kachkov
+*/
+#include <math.h>
+#include <algorithm>
+#include "gravity.h"
+
+const size_t GravityTree::null;
+/// max depth of tree
+const int max_tree_depth = 40;
+
+void GravityTree::Clear ()
+{
+	positions.clear ();
+	masses.clear ();
+}
+
+void GravityTree::AddMass (vector2d position, double mass)
+{
+	positions.push_back (position);
+	masses.push_back (mass);
+}
+
+void GravityTree::Build ()
+{
+	nodes.clear ();
+	if (positions.empty ())
+		return;
+	order.resize (positions.size ());
+	vector2d lb = positions[0], rt = positions[0];
+	for (size_t i = 0; i < positions.size (); i++)
+	{
+		order[i] = i;
+		lb.x = std::min (lb.x, positions[i].x);
+		lb.y = std::min (lb.y, positions[i].y);
+		rt.x = std::max (rt.x, positions[i].x);
+		rt.y = std::max (rt.y, positions[i].y);
+	}
+	Node root;
+	root.center = (lb + rt) * 0.5;
+	root.half = std::max (rt.x - lb.x, rt.y - lb.y) * 0.5;
+	nodes.push_back (root);
+	Split (0, 0, order.size (), 0);
+}
+
+void GravityTree::Split (size_t node, size_t begin, size_t end, int depth)
+{
+	nodes[node].mass = 0.0;
+	nodes[node].mass_center = vector2d ();
+	nodes[node].children = null;
+	for (size_t i = begin; i < end; i++)
+	{
+		nodes[node].mass += masses[order[i]];
+		nodes[node].mass_center += positions[order[i]] * masses[order[i]];
+	}
+	if (nodes[node].mass > 0.0)
+		nodes[node].mass_center = nodes[node].mass_center / nodes[node].mass;
+	if (end - begin <= 1 || depth >= max_tree_depth)
+		return;
+
+	//quadrants: bottom left, bottom right, top left, top right
+	vector2d center = nodes[node].center;
+	const std::vector<vector2d> &p = positions;
+	size_t *first = order.data () + begin, *last = order.data () + end;
+	size_t *top = std::partition (first, last, [&p, center] (size_t i) { return p[i].y < center.y; });
+	size_t *bottom_right = std::partition (first, top, [&p, center] (size_t i) { return p[i].x < center.x; });
+	size_t *top_right = std::partition (top, last, [&p, center] (size_t i) { return p[i].x < center.x; });
+	size_t bounds[5] = {begin, (size_t)(bottom_right - order.data ()), (size_t)(top - order.data ()),
+						(size_t)(top_right - order.data ()), end};
+
+	size_t children = nodes.size ();
+	double half = nodes[node].half * 0.5;
+	for (int k = 0; k < 4; k++)
+	{
+		Node child;
+		child.center = center + vector2d ((k & 1) ? half : -half, (k & 2) ? half : -half);
+		child.half = half;
+		nodes.push_back (child);
+	}
+	nodes[node].children = children;
+	for (int k = 0; k < 4; k++)
+		Split (children + k, bounds[k], bounds[k + 1], depth + 1);
+}
+
+vector2d GravityTree::Field (vector2d position, double theta, double softening) const
+{
+	vector2d field;
+	if (nodes.empty ())
+		return field;
+	size_t stack[4 * max_tree_depth + 4];
+	size_t stack_size = 0;
+	stack[stack_size++] = 0;
+	double sqr_softening = softening * softening;
+	while (stack_size)
+	{
+		const Node &node = nodes[stack[--stack_size]];
+		if (node.mass <= 0.0)
+			continue;
+		vector2d mass_center = node.mass_center;
+		vector2d d = mass_center - position;
+		double sqr_distance = d.sqr_len ();
+		if (node.children != null && 4.0 * node.half * node.half >= theta * theta * sqr_distance)
+		{
+			for (size_t k = 0; k < 4; k++)
+				stack[stack_size++] = node.children + k;
+			continue;
+		}
+		if (sqr_distance < DBL_EPSILON)
+			continue;
+		double r2 = sqr_distance + sqr_softening;
+		field += d * (node.mass / (r2 * sqrt (r2)));
+	}
+	return field;
+}
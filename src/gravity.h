@@ -0,0 +1,68 @@
+/**
+@file
+@brief mutual gravity of point masses
+@author Sergei Kachkov
+*/
+#pragma once
+#include <vector>
+#include "vector.h"
+
+/**
+@class
+@brief quadtree of point masses for approximate calculation of their gravity (Barnes-Hut method)
+@note tree is built in O(n log n); far cells act as their center of mass, so field in point is found in O(log n)
+*/
+class GravityTree
+{
+private:
+	struct Node
+	{
+		vector2d center;
+		double half;
+		vector2d mass_center;
+		double mass;
+		/// index of the first of 4 children; null for leaves
+		size_t children;
+	};
+	std::vector<Node> nodes;
+	std::vector<vector2d> positions;
+	std::vector<double> masses;
+	std::vector<size_t> order;
+	/**
+	@brief computes mass of node and splits it to quadrants
+	@param node index of node
+	@param begin, end range of masses of node in order array
+	@param depth depth of node; deep nodes are not split, so coincident masses don't split forever
+	*/
+	void Split (size_t node, size_t begin, size_t end, int depth);
+public:
+	static const size_t null = (size_t)-1;
+	/**
+	@return bytes of arrays of tree
+	*/
+	size_t Memory () const
+	{
+		return nodes.capacity () * sizeof (Node) + positions.capacity () * sizeof (vector2d) +
+			masses.capacity () * sizeof (double) + order.capacity () * sizeof (size_t);
+	}
+	/**
+	@brief removes all masses
+	*/
+	void Clear ();
+	/**
+	@brief adds point mass; tree must be built again after adding
+	*/
+	void AddMass (vector2d position, double mass);
+	/**
+	@brief builds tree of added masses
+	*/
+	void Build ();
+	/**
+	@brief calculates gravitational field of all masses divided by gravitational constant
+	@param position point where field is calculated
+	@param theta accuracy parameter; cell is treated as one mass if its size to distance ratio is less than theta
+	@param softening distance that is added to all distances to smooth close encounters
+	@note mass in position itself doesn't act
+	*/
+	vector2d Field (vector2d position, double theta, double softening) const;
+};
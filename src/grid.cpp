@@ -0,0 +1,69 @@
+/**
+@file
+@brief implementation of spatial hashing grid
+@author Sergei Kachkov
+*/
+#include "grid.h"
+#include "physics.h"
+
+SpatialHash::SpatialHash () :
+	cell (1.0),
+	mask (0)
+{
+}
+
+void SpatialHash::Build (const std::vector<Particle> &particles, double cell_size)
+{
+	cell = cell_size;
+	//number of buckets is power of two and at least twice bigger than number of particles
+	size_t buckets = 16;
+	while (buckets < 2 * particles.size ())
+		buckets <<= 1;
+	mask = buckets - 1;
+
+	start.assign (buckets + 1, 0);
+	items.resize (particles.size ());
+	bucket_of.resize (particles.size ());
+	for (size_t i = 0; i < particles.size (); i++)
+	{
+		int x, y;
+		Cell (particles[i].cur_pos, &x, &y);
+		bucket_of[i] = Bucket (x, y);
+		start[bucket_of[i] + 1]++;
+	}
+	for (size_t i = 0; i < buckets; i++)
+		start[i + 1] += start[i];
+	//start of bucket is used as insertion cursor and shifted back after sorting
+	for (size_t i = 0; i < particles.size (); i++)
+		items[start[bucket_of[i]]++] = i;
+	for (size_t i = buckets; i > 0; i--)
+		start[i] = start[i - 1];
+	start[0] = 0;
+}
+
+void SpatialHash::Cell (vector2d point, int *x, int *y)
+{
+	*x = (int)floor (point.x / cell);
+	*y = (int)floor (point.y / cell);
+}
+
+size_t SpatialHash::Bucket (int x, int y)
+{
+	return (((unsigned int)x * 73856093u) ^ ((unsigned int)y * 19349663u)) & mask;
+}
+
+size_t SpatialHash::Buckets ()
+{
+	return mask + 1;
+}
+
+void SpatialHash::Items (size_t bucket, const size_t **begin, const size_t **end)
+{
+	*begin = items.data () + start[bucket];
+	*end = items.data () + start[bucket + 1];
+}
+
+const std::vector<size_t> &SpatialHash::Order ()
+{
+	return items;
+}
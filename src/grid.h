@@ -0,0 +1,66 @@
+/**
+@file
+@brief spatial hashing grid for neighbour search
+@author Sergei Kachkov
+*/
+#pragma once
+#include <vector>
+#include "vector.h"
+#include "boundingbox.h"
+
+struct Particle;
+
+/**
+@class
+@brief uniform grid of unbounded size; cells are mapped to fixed number of buckets by hash
+@note grid is rebuilt from scratch by counting sort; memory is reused between builds
+*/
+class SpatialHash
+{
+private:
+	double cell;
+	size_t mask;
+	std::vector<size_t> start;
+	std::vector<size_t> items;
+	std::vector<size_t> bucket_of;
+public:
+	SpatialHash ();
+	/**
+	@return bytes of arrays of grid
+	*/
+	size_t Memory () const
+	{
+		return (start.capacity () + items.capacity () + bucket_of.capacity ()) * sizeof (size_t);
+	}
+	/**
+	@brief puts particles in grid
+	@param particles array of particles
+	@param cell_size size of grid cell; should be not less than diameter of the biggest particle
+	*/
+	void Build (const std::vector<Particle> &particles, double cell_size);
+	/**
+	@brief calculates cell that contains point
+	@param point coordinates of point
+	@param x, y pointers to coordinates of cell
+	*/
+	void Cell (vector2d point, int *x, int *y);
+	/**
+	@return index of bucket that contains cell
+	*/
+	size_t Bucket (int x, int y);
+	/**
+	@return number of buckets
+	*/
+	size_t Buckets ();
+	/**
+	@brief gives items of bucket
+	@param bucket index of bucket
+	@param begin, end pointers to range of indexes of particles in this bucket
+	@warning bucket can contain particles from distant cells with the same hash
+	*/
+	void Items (size_t bucket, const size_t **begin, const size_t **end);
+	/**
+	@return indexes of all particles sorted by buckets
+	*/
+	const std::vector<size_t> &Order ();
+};
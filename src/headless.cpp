@@ -0,0 +1,66 @@
+/**
+@file
+@brief simulation server without window; state of world is streamed to clients over socket
+@author Sergei Kachkov
+@note usage: physics_server [unix:path | tcp:port] [scene file] [quantum]; by default unix:physics.sock scene.txt 0.001
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <chrono>
+#include "physics.h"
+#include "loader.h"
+#include "server.h"
+
+static volatile sig_atomic_t is_running = 1;
+
+static void stop (int)
+{
+	is_running = 0;
+}
+
+int main (int argc, char *argv[])
+{
+	const char *address = argc > 1 ? argv[1] : "unix:physics.sock";
+	const char *scene = argc > 2 ? argv[2] : "scene.txt";
+	double quantum = argc > 3 ? atof (argv[3]) : 0.001;
+	if (strncmp (address, "unix:", 5) && strncmp (address, "tcp:", 4))
+	{
+		printf ("usage: %s [unix:path | tcp:port] [scene file] [quantum]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	InitLog ();
+	signal (SIGINT, stop);
+	signal (SIGTERM, stop);
+
+	double timestep = 0.002;
+	Physics world (timestep, vector2d (0, -30), BoundingBox (vector2d(-100, -100), vector2d(100, 100)));
+	load_scene (&world, scene);
+
+	StateServer server (quantum);
+	if (!strncmp (address, "tcp:", 4))
+		server.ListenTcp ((unsigned short)atoi (address + 4));
+	else
+		server.ListenUnix (address + 5);
+
+	//world is stepped in real time; time between steps is spent on waiting for clients
+	std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now ();
+	std::chrono::microseconds step ((long long)(timestep * 1e6));
+	while (is_running)
+	{
+		server.ApplyCommands (world);
+		world.Update (1);
+		server.Broadcast (world);
+		next += step;
+		std::chrono::steady_clock::time_point now;
+		while (is_running && (now = std::chrono::steady_clock::now ()) < next)
+			server.Poll ((int)std::chrono::duration_cast<std::chrono::milliseconds> (next - now).count ());
+		//server that falls behind doesn't try to catch up
+		if (now > next + step)
+			next = now;
+	}
+	log (LOG_INFO, "server stopped");
+	return 0;
+}
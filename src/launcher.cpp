@@ -0,0 +1,250 @@
+/**
+@file
+@brief launcher of world that is decomposed to strips simulated by separate processes
+@author Sergei Kachkov
+@note usage: physics_domains [domains] [steps] [rows of boxes] [scene file] [compare];
+boxes fall into scene and every strip is simulated by forked process; with "compare" the same scene is
+simulated by one process and positions of bodies are compared; exit code is not zero if they differ more than
+by thresholds. Piles of several rows are chaotic even in one process, so default scene is one row that settles
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <chrono>
+#include <map>
+#include "physics.h"
+#include "loader.h"
+#include "domain.h"
+
+static const double timestep = 0.002;
+static const unsigned int iterations = 4;
+static const double x_first = -5.0, x_last = 5.0;
+/// thresholds of comparison with single process: mean and max distance between centers of body, bodies in one run only
+static const double max_mean_error = 0.02, max_error = 0.1;
+static const size_t max_missing = 0;
+
+/**
+@brief generates boxes that are the same for all processes; index of box is id of body
+*/
+static std::vector<std::vector<Point> > generate_boxes (int rows)
+{
+	std::vector<std::vector<Point> > boxes;
+	for (int i = 0; i < rows; i++)
+		for (int j = 0; j < 20; j++)
+		{
+			vector2d center (-4.5 + j * 0.47 + (i % 2) * 0.1, 1.5 + i * 0.45);
+			std::vector<Point> box;
+			box.push_back (Point (center + vector2d (-0.15, -0.15), 1.0));
+			box.push_back (Point (center + vector2d (0.15, -0.15), 1.0));
+			box.push_back (Point (center + vector2d (0.15, 0.15), 1.0));
+			box.push_back (Point (center + vector2d (-0.15, 0.15), 1.0));
+			boxes.push_back (box);
+		}
+	return boxes;
+}
+
+static void write_all (int socket, const std::string &data)
+{
+	size_t sent = 0;
+	while (sent < data.size ())
+	{
+		ssize_t bytes = write (socket, data.data () + sent, data.size () - sent);
+		if (bytes <= 0)
+			log (LOG_FAIL, "can not send result of subdomain");
+		sent += bytes;
+	}
+}
+
+/**
+@brief reads centers of bodies sent by subdomain until it closes socket
+*/
+static void read_centers (int socket, std::map<size_t, vector2d> *centers)
+{
+	std::string data;
+	char buffer[65536];
+	ssize_t bytes;
+	while ((bytes = read (socket, buffer, sizeof (buffer))) > 0)
+		data.append (buffer, bytes);
+	for (size_t pos = 0; pos + sizeof (size_t) + sizeof (vector2d) <= data.size (); pos += sizeof (size_t) + sizeof (vector2d))
+	{
+		size_t id;
+		vector2d center;
+		memcpy (&id, data.data () + pos, sizeof (size_t));
+		memcpy (&center, data.data () + pos + sizeof (size_t), sizeof (vector2d));
+		(*centers)[id] = center;
+	}
+}
+
+static vector2d center_of (DynamicBody &body)
+{
+	vector2d center;
+	for (size_t i = 0; i < body.points.size (); i++)
+		center += body.points[i].cur_pos;
+	return center / (double)body.points.size ();
+}
+
+/**
+@brief simulates strip in child process and sends centers of owned bodies to parent
+*/
+static void run_subdomain (int domain, int domains, int left, int right, int result, int steps,
+						   const std::vector<std::vector<Point> > &boxes, const char *scene)
+{
+	char log_path[64];
+	sprintf (log_path, "log_domain%d.txt", domain);
+	InitLog (log_path);
+	double width = (x_last - x_first) / domains;
+	Subdomain subdomain (timestep, vector2d (0, -30), BoundingBox (vector2d(-100, -100), vector2d(100, 100)),
+						 x_first + width * domain, x_first + width * (domain + 1), 0.6);
+	subdomain.Connect (left, right);
+	load_scene (&subdomain.world, scene);
+	for (size_t i = 0; i < boxes.size (); i++)
+		subdomain.AddBody (i, 0.1, boxes[i]);
+	for (int i = 0; i < steps; i++)
+		subdomain.Step (iterations);
+
+	std::vector<std::pair<size_t, size_t> > owned;
+	subdomain.OwnedBodies (&owned);
+	std::string data;
+	for (size_t i = 0; i < owned.size (); i++)
+	{
+		vector2d center = center_of (subdomain.world.DynamicBodies[owned[i].second]);
+		data.append ((const char *)&owned[i].first, sizeof (size_t));
+		data.append ((const char *)&center, sizeof (vector2d));
+	}
+	write_all (result, data);
+	log (LOG_INFO, "subdomain %d finished with %u bodies", domain, (unsigned int)owned.size ());
+	CloseLog ();
+}
+
+int main (int argc, char *argv[])
+{
+	int domains = argc > 1 ? atoi (argv[1]) : 4;
+	int steps = argc > 2 ? atoi (argv[2]) : 1000;
+	int rows = argc > 3 ? atoi (argv[3]) : 1;
+	const char *scene = argc > 4 ? argv[4] : "scene.txt";
+	bool compare = argc > 5 && !strcmp (argv[5], "compare");
+	if (domains < 1 || steps < 0 || rows < 0)
+	{
+		printf ("usage: %s [domains] [steps] [rows of boxes] [scene file] [compare]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	InitLog ();
+	std::vector<std::vector<Point> > boxes = generate_boxes (rows);
+
+	//neighbors[k] connects strip k with strip k + 1; results[k] sends bodies of strip k to launcher
+	std::vector<int> neighbors (2 * domains, -1), results (2 * domains, -1);
+	for (int k = 0; k < domains; k++)
+		if ((k + 1 < domains && socketpair (AF_UNIX, SOCK_STREAM, 0, &neighbors[2 * k])) ||
+			socketpair (AF_UNIX, SOCK_STREAM, 0, &results[2 * k]))
+			log (LOG_FAIL, "can not create sockets of subdomains");
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+	std::vector<pid_t> children;
+	for (int k = 0; k < domains; k++)
+	{
+		pid_t pid = fork ();
+		if (pid < 0)
+			log (LOG_FAIL, "can not start process of subdomain");
+		if (pid == 0)
+		{
+			//child keeps only its own sockets, so it sees when neighbor exits
+			int left = k > 0 ? neighbors[2 * (k - 1) + 1] : -1, right = k + 1 < domains ? neighbors[2 * k] : -1;
+			for (int i = 0; i < 2 * domains; i++)
+			{
+				if (neighbors[i] >= 0 && neighbors[i] != left && neighbors[i] != right)
+					close (neighbors[i]);
+				if (results[i] >= 0 && i != 2 * k + 1)
+					close (results[i]);
+			}
+			run_subdomain (k, domains, left, right, results[2 * k + 1], steps, boxes, scene);
+			_exit (0);
+		}
+		children.push_back (pid);
+	}
+	for (int i = 0; i < 2 * domains; i++)
+		if (neighbors[i] >= 0)
+			close (neighbors[i]);
+
+	std::map<size_t, vector2d> centers;
+	for (int k = 0; k < domains; k++)
+	{
+		close (results[2 * k + 1]);
+		read_centers (results[2 * k], &centers);
+		close (results[2 * k]);
+	}
+	bool failed = false;
+	for (size_t k = 0; k < children.size (); k++)
+	{
+		int status;
+		waitpid (children[k], &status, 0);
+		failed = failed || !WIFEXITED (status) || WEXITSTATUS (status);
+	}
+	double decomposed_time = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+	if (failed)
+	{
+		printf ("subdomain failed; see log_domain*.txt\n");
+		return EXIT_FAILURE;
+	}
+	printf ("%d subdomains: %u of %u bodies in world after %d steps, %.2f s\n", domains, (unsigned int)centers.size (),
+			(unsigned int)boxes.size (), steps, decomposed_time);
+
+	if (compare)
+	{
+		start = std::chrono::steady_clock::now ();
+		Physics world (timestep, vector2d (0, -30), BoundingBox (vector2d(-100, -100), vector2d(100, 100)));
+		load_scene (&world, scene);
+		std::vector<size_t> handles;
+		for (size_t i = 0; i < boxes.size (); i++)
+			handles.push_back (world.GetHandle (world.AddDynamicBody (0.1, boxes[i])));
+		for (int i = 0; i < steps; i++)
+			world.Update (iterations);
+		double single_time = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+
+		//single bodies of piles diverge by chaos of contacts, but mean position of all bodies should stay the same
+		size_t matched = 0, missing = 0;
+		double error_sum = 0.0, error_max = 0.0;
+		vector2d single_mean, decomposed_mean;
+		for (size_t i = 0; i < handles.size (); i++)
+		{
+			size_t body;
+			std::map<size_t, vector2d>::iterator center = centers.find (i);
+			if (!world.FindBody (handles[i], &body))
+			{
+				missing += center != centers.end ();
+				continue;
+			}
+			if (center == centers.end ())
+			{
+				missing++;
+				continue;
+			}
+			single_mean += center_of (world.DynamicBodies[body]);
+			decomposed_mean += center->second;
+			double error = (center_of (world.DynamicBodies[body]) - center->second).len ();
+			error_sum += error;
+			error_max = std::max (error_max, error);
+			matched++;
+		}
+		double error_mean = matched ? error_sum / matched : 0.0;
+		printf ("single process: %u bodies, %.2f s\n", (unsigned int)world.DynamicBodies.size (), single_time);
+		printf ("difference of centers: mean %.4f, max %.4f; bodies in one run only: %u\n", error_mean, error_max,
+				(unsigned int)missing);
+		if (matched)
+			printf ("mean center of bodies: single (%.4f %.4f), decomposed (%.4f %.4f)\n", single_mean.x / matched,
+					single_mean.y / matched, decomposed_mean.x / matched, decomposed_mean.y / matched);
+		if (error_mean > max_mean_error || error_max > max_error || missing > max_missing)
+		{
+			printf ("decomposed run differs from single process more than by thresholds (mean %.4f, max %.4f, %u bodies)\n",
+					max_mean_error, max_error, (unsigned int)max_missing);
+			CloseLog ();
+			return EXIT_FAILURE;
+		}
+		printf ("decomposed run matches single process\n");
+	}
+	CloseLog ();
+	return 0;
+}
@@ -5,10 +5,22 @@
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#include <vector>
+#include <string>
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
 #include "loader.h"
 #include "physics.h"
+#include "bake.h"
 #include "log.h"
 
+/// header of baked scene; version is changed with format of file or with baking algorithm
+static const char baked_magic[8] = "BAKED01";
+
 bool is_valid (const char *str)
 {
 	for (int i = 0; i < strlen (str); i++)
@@ -25,47 +37,220 @@ bool next_str (FILE *f, char *str, size_t max_len)
 {
 	do
 	{
-		if (feof (f))
+		if (!fgets (str, max_len, f))
 			return false;
-		fgets (str, max_len, f);
 	} while (!is_valid (str));
 	return true;
 }
 
-void load_scene (Physics *engine, const char *path)
+/**
+@brief FNV-1a hash of scene file; baked scene is valid only for source with the same hash
+*/
+static unsigned long long hash_of (const std::string &data)
 {
-	FILE *f = fopen (path, "r");
-	if (f)
-		log (LOG_INFO, "scene file %s was opened successfully", path);
+	unsigned long long hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < data.size (); i++)
+		hash = (hash ^ (unsigned char)data[i]) * 1099511628211ULL;
+	return hash;
+}
+
+static bool read_file (FILE *f, std::string *data)
+{
+	char buffer[65536];
+	size_t bytes;
+	data->clear ();
+	while ((bytes = fread (buffer, 1, sizeof (buffer), f)) > 0)
+		data->append (buffer, bytes);
+	return !ferror (f);
+}
+
+//----------encoding of baked scene-------------------------
+template <class T>
+static void put (std::string *out, const T &value)
+{
+	out->append ((const char *)&value, sizeof (T));
+}
+
+template <class T>
+static bool get (const std::string &in, size_t *pos, T *value)
+{
+	if (in.size () - *pos < sizeof (T))
+		return false;
+	memcpy (value, in.data () + *pos, sizeof (T));
+	*pos += sizeof (T);
+	return true;
+}
+
+static void put_polygons (std::string *out, const std::vector<std::vector<vector2d> > &polygons)
+{
+	put (out, (size_t)polygons.size ());
+	for (size_t i = 0; i < polygons.size (); i++)
+	{
+		put (out, (size_t)polygons[i].size ());
+		out->append ((const char *)&polygons[i][0], polygons[i].size () * sizeof (vector2d));
+	}
+}
+
+/**
+@param min_size min number of vertexes that engine accepts: 3 for pieces, 2 for polylines of terrains
+@return false, if data is cut or polygon is too small; such baked scene is baked again
+*/
+static bool get_polygons (const std::string &in, size_t *pos, size_t min_size, std::vector<std::vector<vector2d> > *polygons)
+{
+	size_t count, size;
+	if (!get (in, pos, &count))
+		return false;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (!get (in, pos, &size) || size < min_size || (in.size () - *pos) / sizeof (vector2d) < size)
+			return false;
+		polygons->push_back (std::vector<vector2d> (size));
+		memcpy (&polygons->back ()[0], in.data () + *pos, size * sizeof (vector2d));
+		*pos += size * sizeof (vector2d);
+	}
+	return true;
+}
+//----------end of encoding of baked scene------------------
+
+/**
+@brief reads baked scene
+@param hash hash of source of scene
+@return false, if there is no baked scene or it was baked from other source or by other version
+*/
+static bool load_baked (const std::string &path, unsigned long long hash, std::vector<std::vector<vector2d> > *pieces,
+						std::vector<std::vector<vector2d> > *terrains)
+{
+	FILE *f = fopen (path.c_str (), "rb");
+	if (!f)
+		return false;
+	std::string data;
+	bool loaded = read_file (f, &data);
+	fclose (f);
+	size_t pos = 0;
+	char magic[sizeof (baked_magic)];
+	unsigned long long source;
+	loaded = loaded && get (data, &pos, &magic) && !memcmp (magic, baked_magic, sizeof (magic)) &&
+			 get (data, &pos, &source) && source == hash &&
+			 get_polygons (data, &pos, 3, pieces) && get_polygons (data, &pos, 2, terrains) && pos == data.size ();
+	if (!loaded)
+	{
+		pieces->clear ();
+		terrains->clear ();
+	}
+	return loaded;
+}
+
+/**
+@brief writes baked scene to temporary file and renames it, so processes that load the same scene don't see partial file
+*/
+static void save_baked (const std::string &path, unsigned long long hash, const std::vector<std::vector<vector2d> > &pieces,
+						const std::vector<std::vector<vector2d> > &terrains)
+{
+	std::string data (baked_magic, sizeof (baked_magic));
+	put (&data, hash);
+	put_polygons (&data, pieces);
+	put_polygons (&data, terrains);
+
+	char suffix[32];
+	sprintf (suffix, ".%d", (int)getpid ());
+	std::string temporary = path + suffix;
+	FILE *f = fopen (temporary.c_str (), "wb");
+	bool saved = f && fwrite (data.data (), 1, data.size (), f) == data.size ();
+	saved = f && !fclose (f) && saved;
+#ifdef _WIN32
+	//rename doesn't replace existing file on Windows; stale baked scene is removed anyway
+	remove (path.c_str ());
+#endif
+	saved = saved && !rename (temporary.c_str (), path.c_str ());
+	if (saved)
+		log (LOG_INFO, "baked scene is saved to %s", path.c_str ());
 	else
-		log (LOG_FAIL, "can not open scene file %s", path);
+	{
+		remove (temporary.c_str ());
+		log (LOG_INFO, "can not save baked scene to %s", path.c_str ());
+	}
+}
 
+/**
+@brief reads polygons of static bodies and terrains from scene file; heightfields are converted to polylines
+*/
+static void parse_scene (FILE *f, std::vector<std::vector<vector2d> > *polygons, std::vector<std::vector<vector2d> > *terrains)
+{
 	char cur_str[256];
 	while (next_str(f, cur_str, 256))
 	{
-		size_t num_points, id;
+		unsigned int num_points;
+		//terrains: "heightfield x0 step n" with n heights or "polyline n" with n points
+		double x0, step;
+		if (sscanf (cur_str, " heightfield %lf %lf %u", &x0, &step, &num_points) == 3)
+		{
+			std::vector<vector2d> points (num_points);
+			for (size_t i = 0; i < num_points; i++)
+			{
+				if (!next_str (f, cur_str, 256))
+					log (LOG_FAIL, "number of heights is not equal to defined number in description of heightfield");
+				points[i].x = x0 + step * i;
+				sscanf (cur_str, "%lf", &points[i].y);
+			}
+			terrains->push_back (points);
+			continue;
+		}
+		if (sscanf (cur_str, " polyline %u", &num_points) == 1)
+		{
+			std::vector<vector2d> points (num_points);
+			for (size_t i = 0; i < num_points; i++)
+			{
+				if (!next_str (f, cur_str, 256))
+					log (LOG_FAIL, "number of points is not equal to defined number in description of polyline");
+				sscanf (cur_str, "%lf %lf", &points[i].x, &points[i].y);
+			}
+			terrains->push_back (points);
+			continue;
+		}
 		sscanf (cur_str, "%u", &num_points);
 		if (num_points < 3)
 			log (LOG_FAIL, "number of points in scene file must be more than 2");
 
-		vector2d p[3];
-		for (size_t i = 0; i < 3; i++)
+		std::vector<vector2d> points (num_points);
+		for (size_t i = 0; i < num_points; i++)
 		{
 			if (!next_str (f, cur_str, 256))
 				log (LOG_FAIL, "number of points is not equal to defined number in description of body");
-			sscanf (cur_str, "%lf %lf", &p[i].x, &p[i].y);
+			sscanf (cur_str, "%lf %lf", &points[i].x, &points[i].y);
 		}
+		polygons->push_back (points);
+	}
+}
 
-		id = engine->AddStaticBody (3, p[0], p[1], p[2]);
+void load_scene (Physics *engine, const char *path)
+{
+	FILE *f = fopen (path, "rb");
+	if (f)
+		log (LOG_INFO, "scene file %s was opened successfully", path);
+	else
+		log (LOG_FAIL, "can not open scene file %s", path);
 
-		for (size_t i = 3; i < num_points; i++)
-		{
-			if (!next_str (f, cur_str, 256))
-				log (LOG_FAIL, "number of points is not equal to defined number in description of body");
-			vector2d p;
-			sscanf (cur_str, "%lf %lf", &p.x, &p.y);
-			engine->StaticBodies[id].AddStaticPoint (p);
-		}
+	std::string source;
+	if (!read_file (f, &source))
+		log (LOG_FAIL, "can not read scene file %s", path);
+	unsigned long long hash = hash_of (source);
+	std::string baked_path = std::string (path) + ".baked";
+	std::vector<std::vector<vector2d> > pieces, terrains;
+	if (load_baked (baked_path, hash, &pieces, &terrains))
+		log (LOG_INFO, "baked scene %s is used", baked_path.c_str ());
+	else
+	{
+		std::vector<std::vector<vector2d> > polygons;
+		rewind (f);
+		parse_scene (f, &polygons, &terrains);
+		bake_polygons (polygons, &pieces);
+		save_baked (baked_path, hash, pieces, terrains);
 	}
+	fclose (f);
+
+	for (size_t i = 0; i < pieces.size (); i++)
+		engine->AddStaticBody (pieces[i]);
+	for (size_t i = 0; i < terrains.size (); i++)
+		engine->AddTerrain (terrains[i]);
 	log (LOG_INFO, "scene have loaded successfully");
-}
\ No newline at end of file
+}
@@ -5,4 +5,16 @@
 #pragma once
 #include "physics.h"
 
+/**
+@brief loads static geometry from scene file
+@param engine world to fill
+@param path path to scene file
+@note file consists of blocks separated by empty lines or comments (lines beginning with %):
+static body is number of points followed by lines "x y" of simple polygon in any direction, it may be concave;
+points that don't form simple polygon are taken as set and replaced with their convex hull;
+heightfield is line "heightfield x0 step n" followed by n lines of heights;
+polyline terrain is line "polyline n" followed by n lines "x y".
+Static bodies are baked to convex pieces, and pieces that share edge are merged while they stay convex.
+Baked scene is saved to file path.baked with hash of scene file and it is loaded instead of baking while scene is not changed.
+*/
 void load_scene (Physics *engine, const char *path);
\ No newline at end of file
@@ -7,13 +7,16 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <time.h>
+#include <mutex>
 #include "log.h"
 
 static FILE *f;
+/// worlds can be updated in several threads
+static std::mutex log_lock;
 
-void InitLog ()
+void InitLog (const char *path)
 {
-	if (!(f = fopen ("log.txt", "w")))
+	if (!(f = fopen (path, "w")))
 	{
 		printf ("ERROR: Can not open log file!");
 		exit (EXIT_FAILURE);
@@ -27,6 +30,7 @@ void CloseLog ()
 
 void log(LOG_TYPE type, const char *format_str, ...)
 {
+	std::lock_guard<std::mutex> guard (log_lock);
 	time_t rawtime;
 	time (&rawtime);
 	char time_str[40];
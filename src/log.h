@@ -13,8 +13,9 @@ enum LOG_TYPE
 
 /**
 @brief opens log
+@param path path of log file; processes of one program should use different files
 */
-void InitLog ();
+void InitLog (const char *path = "log.txt");
 /**
 @brief writes to log; format: [time] [label] [your message] 
 @param type type of error: LOG_INFO - write note, LOG_FAIL - write error
@@ -48,9 +48,12 @@ bool input (Window *window)
 	static bool toogle_fullscreen = false;
 	static bool is_move = false;
 	static bool is_add = false;
+	static bool is_add_particles = false;
+	static bool is_add_jelly = false;
+	static bool is_add_rope = false;
 	static vector2d old_center, mouse_center;
 	static bool is_fixed = false;
-	static std::vector<Point>::iterator fixed_point;
+	static ArenaVector<Point>::iterator fixed_point;
 	
 	// closing app
 	if (keys[27])
@@ -96,15 +99,12 @@ bool input (Window *window)
 			fixed_point->cur_pos = camera.ToWorld (mouse.x, mouse.y);
 		else
 		{
-			double min_sqr_len = 0.01;
-			vector2d mouse_world = camera.ToWorld (mouse.x, mouse.y);
-			for (size_t i = 0; i < world.DynamicBodies.size (); i++)
-				for (size_t j = 0; j < world.DynamicBodies[i].points.size (); j++)
-					if ((world.DynamicBodies[i].points[j].cur_pos - mouse_world).sqr_len () < min_sqr_len)
-					{
-						fixed_point = world.DynamicBodies[i].points.begin () + j;
-						is_fixed = true;
-					}
+			size_t body, point;
+			if (world.FindNearestPoint (camera.ToWorld (mouse.x, mouse.y), 0.1, &body, &point))
+			{
+				fixed_point = world.DynamicBodies[body].points.begin () + point;
+				is_fixed = true;
+			}
 		}
 	}
 	else if (is_fixed)
@@ -122,72 +122,190 @@ bool input (Window *window)
 							  Point (center + vector2d (0.25, 0.25), 1.0),
 							  Point (center + vector2d (-0.25, 0.25), 1.0));
 	}
-		
+
+	//add block of particles
+	if (keys[(unsigned char)'p'] || keys[(unsigned char)'P'])
+		is_add_particles = true;
+	else if (is_add_particles)
+	{
+		is_add_particles = false;
+		vector2d center = camera.ToWorld (mouse.x, mouse.y);
+		for (int i = -5; i < 5; i++)
+			for (int j = -5; j < 5; j++)
+				world.AddParticle (center + vector2d (i * 0.05 + 0.025, j * 0.05 + 0.025), 0.025, 0.1);
+	}
+
+	//add lattice soft body
+	if (keys[(unsigned char)'j'] || keys[(unsigned char)'J'])
+		is_add_jelly = true;
+	else if (is_add_jelly)
+	{
+		is_add_jelly = false;
+		vector2d center = camera.ToWorld (mouse.x, mouse.y);
+		size_t jelly = world.AddLatticeBody (8, 8, center - vector2d (0.35, 0.35), 0.1, 0.05, 0.02);
+		world.LatticeBodies[jelly].SetCompliance (1e-5, 1e-5, 1e-4);
+	}
+
+	//add rope hanging from cursor
+	if (keys[(unsigned char)'r'] || keys[(unsigned char)'R'])
+		is_add_rope = true;
+	else if (is_add_rope)
+	{
+		is_add_rope = false;
+		vector2d center = camera.ToWorld (mouse.x, mouse.y);
+		size_t rope = world.AddRope (center, center + vector2d (3.0, 0.0), 60, 0.01, 0.02);
+		world.Ropes[rope].Pin (0);
+	}
 
 	return true;
 }
 
+// arrays of frame geometry; memory is kept between frames
+std::vector<GLdouble> vertexes;
+std::vector<GLuint> static_lines, edge_lines, pole_lines;
+std::vector<size_t> visible_static, visible_dynamic;
+
 /**
 @brief renders objects that pass screen culling
+@note visible bodies are found in broad phase of engine; geometry of frame is drawn by few batched calls
 */
 void render ()
 {
 	glClear (GL_COLOR_BUFFER_BIT);
-	
-	size_t drawed_static = 0, drawed_dynamic = 0;
-	//Draw static objects
-	glColor3f (1.0, 0.0, 0.0);
-	for (size_t i = 0; i < world.StaticBodies.size (); i++)
-		if (world.StaticBodies[i].bbox * camera.view_field)
+
+	visible_static.clear ();
+	visible_dynamic.clear ();
+	world.QueryBodies (camera.view_field, &visible_static, &visible_dynamic);
+
+	vertexes.clear ();
+	static_lines.clear ();
+	edge_lines.clear ();
+	pole_lines.clear ();
+	//static objects
+	for (size_t i = 0; i < visible_static.size (); i++)
+	{
+		std::vector<vector2d> &points = world.StaticBodies[visible_static[i]].points;
+		GLuint first = (GLuint)(vertexes.size () / 2);
+		for (size_t j = 0; j < points.size (); j++)
+		{
+			vertexes.push_back (points[j].x);
+			vertexes.push_back (points[j].y);
+			static_lines.push_back (first + (GLuint)j);
+			static_lines.push_back (first + (GLuint)((j + 1) % points.size ()));
+		}
+	}
+	//dynamic objects
+	GLuint dynamic_first = (GLuint)(vertexes.size () / 2);
+	for (size_t i = 0; i < visible_dynamic.size (); i++)
+	{
+		DynamicBody &body = world.DynamicBodies[visible_dynamic[i]];
+		GLuint first = (GLuint)(vertexes.size () / 2);
+		for (size_t j = 0; j < body.points.size (); j++)
+		{
+			vertexes.push_back (body.points[j].cur_pos.x);
+			vertexes.push_back (body.points[j].cur_pos.y);
+		}
+		for (size_t j = 0; j < body.edges.size (); j++)
+		{
+			edge_lines.push_back (first + (GLuint)body.edges[j].p1);
+			edge_lines.push_back (first + (GLuint)body.edges[j].p2);
+		}
+		for (size_t j = 0; j < body.poles.size (); j++)
 		{
-			drawed_static++;
-			//draw figure
-			glBegin (GL_LINE_LOOP);
-			for (size_t j = 0; j < world.StaticBodies[i].points.size (); j++)
-				glVertex2d (world.StaticBodies[i].points[j].x,
-							world.StaticBodies[i].points[j].y);
-			glEnd ();
+			pole_lines.push_back (first + (GLuint)body.poles[j].p1);
+			pole_lines.push_back (first + (GLuint)body.poles[j].p2);
 		}
+	}
 
-	//Draw dynamic objects
-	for (size_t i = 0; i < world.DynamicBodies.size (); i++)
-		if (world.DynamicBodies[i].bbox * camera.view_field)
+	//lattice bodies: structural constraints and outline
+	for (size_t i = 0; i < world.LatticeBodies.size (); i++)
+	{
+		LatticeBody &body = world.LatticeBodies[i];
+		if (!(body.bbox * camera.view_field))
+			continue;
+		GLuint first = (GLuint)(vertexes.size () / 2);
+		for (size_t j = 0; j < body.points.size (); j++)
+		{
+			vertexes.push_back (body.points[j].cur_pos.x);
+			vertexes.push_back (body.points[j].cur_pos.y);
+		}
+		for (size_t b = 0; b < body.batches.size (); b++)
+			if (body.batches[b].kind == LATTICE_STRUCTURAL)
+				for (size_t k = 0; k < body.batches[b].first.size (); k++)
+				{
+					pole_lines.push_back (first + (GLuint)body.batches[b].first[k]);
+					pole_lines.push_back (first + (GLuint)body.batches[b].second[k]);
+				}
+		for (size_t j = 0; j < body.boundary.size (); j++)
 		{
-			drawed_dynamic++;
-			//draw poles
-			glColor3f (0.5, 0.5, 0.5);
-			glBegin (GL_LINES);
-			for (size_t j = 0; j < world.DynamicBodies[i].poles.size (); j++)
+			edge_lines.push_back (first + (GLuint)body.boundary[j]);
+			edge_lines.push_back (first + (GLuint)body.boundary[(j + 1) % body.boundary.size ()]);
+		}
+	}
+
+	//ropes
+	for (size_t i = 0; i < world.Ropes.size (); i++)
+	{
+		Rope &rope = world.Ropes[i];
+		if (!(rope.bbox * camera.view_field))
+			continue;
+		GLuint first = (GLuint)(vertexes.size () / 2);
+		for (size_t j = 0; j < rope.points.size (); j++)
+		{
+			vertexes.push_back (rope.points[j].cur_pos.x);
+			vertexes.push_back (rope.points[j].cur_pos.y);
+			if (j > 0)
 			{
-				glVertex2d (world.DynamicBodies[i].points[world.DynamicBodies[i].poles[j].p1].cur_pos.x,
-							world.DynamicBodies[i].points[world.DynamicBodies[i].poles[j].p1].cur_pos.y);
-				glVertex2d (world.DynamicBodies[i].points[world.DynamicBodies[i].poles[j].p2].cur_pos.x,
-							world.DynamicBodies[i].points[world.DynamicBodies[i].poles[j].p2].cur_pos.y);
+				edge_lines.push_back (first + (GLuint)j - 1);
+				edge_lines.push_back (first + (GLuint)j);
 			}
-			glEnd ();
-
-			//draw figure
-			glColor3f (0.0, 1.0, 0.0);
-			glBegin (GL_LINE_LOOP);
-			for (size_t j = 0; j < world.DynamicBodies[i].points.size (); j++)
-				glVertex2d (world.DynamicBodies[i].points[j].cur_pos.x,
-							world.DynamicBodies[i].points[j].cur_pos.y);
-			glEnd ();
-
-			//draw vertexes
-			glColor3f (1.0, 1.0, 1.0);
-			glBegin (GL_POINTS);
-			for (size_t j = 0; j < world.DynamicBodies[i].points.size (); j++)
-				glVertex2d (world.DynamicBodies[i].points[j].cur_pos.x,
-							world.DynamicBodies[i].points[j].cur_pos.y);
-			glEnd ();
 		}
+	}
+
+	//client-side vertex arrays of OpenGL 1.1 work on any implementation including software ones
+	glEnableClientState (GL_VERTEX_ARRAY);
+	if (!vertexes.empty ())
+	{
+		glVertexPointer (2, GL_DOUBLE, 0, vertexes.data ());
+		glColor3f (1.0, 0.0, 0.0);
+		glDrawElements (GL_LINES, (GLsizei)static_lines.size (), GL_UNSIGNED_INT, static_lines.data ());
+		glColor3f (0.5, 0.5, 0.5);
+		glDrawElements (GL_LINES, (GLsizei)pole_lines.size (), GL_UNSIGNED_INT, pole_lines.data ());
+		glColor3f (0.0, 1.0, 0.0);
+		glDrawElements (GL_LINES, (GLsizei)edge_lines.size (), GL_UNSIGNED_INT, edge_lines.data ());
+		glColor3f (1.0, 1.0, 1.0);
+		glDrawArrays (GL_POINTS, dynamic_first, (GLsizei)(vertexes.size () / 2 - dynamic_first));
+	}
+
+	//visible parts of terrains are drawn straight from arrays of engine
+	glColor3f (1.0, 0.0, 0.0);
+	for (size_t i = 0; i < world.Terrains.size (); i++)
+	{
+		size_t first, last;
+		if (world.Terrains[i].Segments (camera.view_field.lb.x, camera.view_field.rt.x, &first, &last))
+		{
+			glVertexPointer (2, GL_DOUBLE, sizeof (vector2d), &world.Terrains[i].points[first]);
+			glDrawArrays (GL_LINE_STRIP, 0, (GLsizei)(last - first + 2));
+		}
+	}
+
+	//particles are drawn straight from array of engine; size of point is diameter of the first particle in pixels
+	if (!world.Particles.empty ())
+	{
+		glColor3f (0.3, 0.6, 1.0);
+		glPointSize ((GLfloat)(world.Particles[0].r * camera.height / camera.scale));
+		glVertexPointer (2, GL_DOUBLE, sizeof (Particle), &world.Particles[0].cur_pos);
+		glDrawArrays (GL_POINTS, 0, (GLsizei)world.Particles.size ());
+		glPointSize (2.0);
+	}
+	glDisableClientState (GL_VERTEX_ARRAY);
 
 	// Print statistics
-	char str[50];
-	sprintf (str, "Objects static: %u; dynamic: %u", world.StaticBodies.size (), world.DynamicBodies.size ());
+	char str[100];
+	sprintf (str, "Objects static: %u; dynamic: %u; particles: %u; lattice: %u; ropes: %u", world.StaticBodies.size (),
+			 world.DynamicBodies.size (), world.Particles.size (), world.LatticeBodies.size (), world.Ropes.size ());
 	Print ((unsigned char *)str, 10, 40, 1.0, 1.0, 1.0);
-	sprintf (str, "Drawed static: %u; dynamic: %u", drawed_static, drawed_dynamic);
+	sprintf (str, "Drawed static: %u; dynamic: %u", visible_static.size (), visible_dynamic.size ());
 	Print ((unsigned char *)str, 10, 60, 1.0, 1.0, 1.0);
 }
 
@@ -204,6 +322,8 @@ int main (int argc, char *argv[])
 			break;
 
 		camera.SetMatrix ();
+		//bodies out of screen are updated less often
+		world.SetRegionOfInterest (camera.view_field, 2.0, 3);
 		world.Update (1);
 		render ();
 		char str[50];
@@ -5,26 +5,86 @@
 */
 #include <stdlib.h>
 #include <stdarg.h>
+#include <string.h>
+#include <algorithm>
 #include "physics.h"
+#include "sat.h"
 #include "log.h"
 
 const double max_depth = 0.01;
+/// number of dynamic bodies processed by one task of update
+const size_t chunk_bodies = 64;
+/// number of particles processed by one task of update
+const size_t chunk_particles = 1024;
+/// number of rays cast by one task of batched ray casting
+const size_t chunk_rays = 256;
+/// handle of body is generation of its slot in upper half of bits and slot in lower half
+const size_t handle_shift = sizeof (size_t) * 4;
+const size_t handle_slot_mask = ((size_t)1 << handle_shift) - 1;
 
-struct Edge
-{
-	std::vector<Point>::iterator p1, p2;
-};
-
-struct CollisionInfo
+/**
+@brief collision detection between circle and convex polygon
+@param center, r center and radius of circle; zero radius tests point
+@param n number of vertexes of polygon
+@param vertex function that returns vertex of polygon by its index
+@param normal pointer to normal that points from polygon to circle
+@param depth pointer to penetration depth
+@param edge pointer to index of first vertex of nearest edge
+@return true, if shapes intersect; false for polygon without edges or circle with NaN center
+*/
+template <class Vertex>
+static bool CircleConvex (vector2d center, double r, size_t n, Vertex vertex,
+						  vector2d *normal, double *depth, size_t *edge)
 {
-	double depth;
-	vector2d normal;
-	Edge edge;
-	std::vector<Point>::iterator point;
-	size_t edge_body, point_body;
-	vector2d static_point;
-	bool is_point;
-}info;
+	//edge of max separation; edges of zero length have no normal
+	double separation = -DBL_MAX;
+	*edge = 0;
+	for (size_t i = 0; i < n; i++)
+	{
+		vector2d p1 = vertex (i), p2 = vertex ((i + 1) % n);
+		vector2d axis = vector2d (p2.y - p1.y, p1.x - p2.x);
+		if (axis.sqr_len () < DBL_MIN)
+			continue;
+		axis = axis.norm ();
+		double distance = axis ^ (center - p1);
+		if (distance > r)
+			return false;
+		if (distance > separation)
+		{
+			separation = distance;
+			*normal = axis;
+			*edge = i;
+		}
+	}
+	//no edges or separation isn't finite (center is NaN)
+	if (!(separation > -DBL_MAX))
+		return false;
+	//center inside of polygon
+	if (separation < DBL_EPSILON)
+	{
+		*depth = r - separation;
+		return true;
+	}
+	//center outside; check vertexes of nearest edge
+	vector2d p1 = vertex (*edge), p2 = vertex ((*edge + 1) % n);
+	vector2d closest;
+	if (((center - p1) ^ (p2 - p1)) < 0.0)
+		closest = p1;
+	else if (((center - p2) ^ (p1 - p2)) < 0.0)
+		closest = p2;
+	else
+	{
+		*depth = r - separation;
+		return true;
+	}
+	vector2d d = center - closest;
+	if (d.sqr_len () > r * r)
+		return false;
+	double distance = d.len ();
+	*normal = d / distance;
+	*depth = r - distance;
+	return true;
+}
 
 //----------implementation of point------------------------
 Point::Point (vector2d position, double mass) :
@@ -42,18 +102,90 @@ void Point::Update (double timestep, vector2d gravity)
 	cur_pos += (cur_pos - old_pos) + gravity * timestep * timestep * 0.5;
 	old_pos = temp;
 }
+
+void Point::Update (double timestep, double previous_timestep, vector2d gravity)
+{
+	vector2d temp = cur_pos;
+	cur_pos += (cur_pos - old_pos) * (timestep / previous_timestep) + gravity * timestep * (timestep + previous_timestep) * 0.25;
+	old_pos = temp;
+}
 //----------end of implementation of point------------------
 
+/**
+@brief finds where segment enters convex polygon (Cyrus-Beck clipping)
+@param from, to ends of segment
+@param n number of vertexes of counter-clockwise polygon
+@param vertex function that returns vertex of polygon by its index
+@param enter pointer to parameter of entry point on segment (0 - from, 1 - to)
+@param normal pointer to outer normal of entered edge
+@return true, if segment enters polygon from outside
+*/
+template <class Vertex>
+static bool SegmentConvex (vector2d from, vector2d to, size_t n, Vertex vertex, double *enter, vector2d *normal)
+{
+	double t_enter = 0.0, t_exit = 1.0;
+	bool entered = false;
+	vector2d d = to - from;
+	for (size_t i = 0; i < n; i++)
+	{
+		vector2d p1 = vertex (i), p2 = vertex ((i + 1) % n);
+		vector2d axis (p2.y - p1.y, p1.x - p2.x);
+		double distance = axis ^ (p1 - from), speed = axis ^ d;
+		if (fabs (speed) < DBL_EPSILON)
+		{
+			//parallel to edge and outside of it
+			if (distance < 0.0)
+				return false;
+			continue;
+		}
+		double t = distance / speed;
+		if (speed < 0.0)
+		{
+			if (t > t_enter)
+			{
+				t_enter = t;
+				*normal = axis;
+				entered = true;
+			}
+		}
+		else if (t < t_exit)
+			t_exit = t;
+		if (t_enter > t_exit)
+			return false;
+	}
+	if (!entered)
+		return false;
+	*enter = t_enter;
+	*normal = normal->norm ();
+	return true;
+}
+
+//----------implementation of particle---------------------
+Particle::Particle (vector2d position, double radius, double mass) :
+	Point (position, mass),
+	r (radius)
+{
+	if (r < DBL_EPSILON)
+		log (LOG_FAIL, "trying to create particle with zero radius");
+}
+//----------end of implementation of particle--------------
+
 //----------impementation of pole---------------------------
 Pole::Pole (size_t point1, size_t point2, double length) :
 	p1 (point1),
 	p2 (point2),
-	len (length)
+	len (length),
+	lambda (0.0)
 {
 }
 //----------end of implementation of pole-------------------
 
 //----------implementation of static body-------------------
+StaticBody::StaticBody () :
+	proxy (AABBTree::null)
+{
+}
+
 void StaticBody::AddStaticPoint (vector2d point)
 {
 	if (!points.size ())
@@ -92,10 +224,97 @@ void StaticBody::ProjectToAxis (vector2d axis, double *min, double *max)
 
 //----------end of implementation of static body------------
 
+//----------implementation of terrain----------------------
+Terrain::Terrain (const std::vector<vector2d> &vertexes) :
+	points (vertexes)
+{
+	Build ();
+}
+
+Terrain::Terrain (double x0, double step, const std::vector<double> &heights)
+{
+	for (size_t i = 0; i < heights.size (); i++)
+		points.push_back (vector2d (x0 + step * i, heights[i]));
+	Build ();
+}
+
+void Terrain::Build ()
+{
+	if (points.size () < 2)
+		log (LOG_FAIL, "terrain must have at least 2 vertices");
+	bbox = BoundingBox ();
+	for (size_t i = 0; i < points.size (); i++)
+	{
+		if (i && points[i].x <= points[i - 1].x)
+			log (LOG_FAIL, "x of terrain vertices must increase");
+		bbox.Expand (points[i]);
+	}
+	//one column per segment; for heightfield column is exactly one segment
+	size_t segments = points.size () - 1;
+	column_width = (bbox.rt.x - bbox.lb.x) / segments;
+	columns.resize (segments);
+	size_t k = 0;
+	for (size_t c = 0; c < segments; c++)
+	{
+		double left = bbox.lb.x + column_width * c;
+		while (k < segments - 1 && points[k + 1].x < left)
+			k++;
+		columns[c] = k;
+	}
+}
+
+bool Terrain::Segments (double x1, double x2, size_t *first, size_t *last) const
+{
+	if (x2 < bbox.lb.x || x1 > bbox.rt.x)
+		return false;
+	size_t segments = points.size () - 1;
+	double column = (x1 - bbox.lb.x) / column_width;
+	size_t k = columns[column <= 0.0 ? 0 : std::min ((size_t)column, segments - 1)];
+	while (k < segments - 1 && points[k + 1].x < x1)
+		k++;
+	*first = k;
+	while (k < segments - 1 && points[k + 1].x < x2)
+		k++;
+	*last = k;
+	return true;
+}
+//----------end of implementation of terrain---------------
+
+//----------implementation of static geometry---------------
+void StaticGeometry::UpdateProxies ()
+{
+	for (size_t i = 0; i < bodies.size (); i++)
+	{
+		StaticBody &body = bodies[i];
+		if (body.proxy == AABBTree::null)
+			body.proxy = tree.CreateProxy (body.bbox, i);
+		else
+		{
+			//points can be added to static body after it was put in tree
+			BoundingBox box = tree.GetBox (body.proxy);
+			if (box.lb.x != body.bbox.lb.x || box.lb.y != body.bbox.lb.y ||
+				box.rt.x != body.bbox.rt.x || box.rt.y != body.bbox.rt.y)
+				tree.MoveProxy (body.proxy, body.bbox);
+		}
+	}
+}
+//----------end of implementation of static geometry--------
+
 //----------implementation of dynamic body------------------
-DynamicBody::DynamicBody (double k) :
+DynamicBody::DynamicBody (double k, Arena *arena, Topology type) :
 	stiffness (k),
-	mass (0.0)
+	compliance (-1.0),
+	mass (0.0),
+	topology (type),
+	points (ArenaAllocator<Point> (arena)),
+	poles (ArenaAllocator<Pole> (arena)),
+	edges (ArenaAllocator<Pole> (arena)),
+	rest (ArenaAllocator<vector2d> (arena)),
+	proxy (AABBTree::null),
+	handle (AABBTree::null),
+	level (0),
+	last_timestep (0.0),
+	active (true)
 {
 }
 
@@ -119,14 +338,62 @@ void DynamicBody::CalculateEdges ()
 {
 	edges.clear ();
 	poles.clear ();
+	rest.clear ();
 	for (size_t i = 0; i < points.size (); i++)
 	{
 		edges.push_back (Pole (i, (i + 1) % points.size (),
 							   (points[i].cur_pos - points[(i + 1) % points.size ()].cur_pos).len ()));
 	}
-	for (size_t i = 0; i < points.size () - 3; i++)
-		for (size_t j = 0; j < points.size () - i - 2; j++)
-			poles.push_back (Pole (j, i + j + 2, (points[j].cur_pos - points[i + j + 2].cur_pos).len ()));
+	if (topology == TOPOLOGY_RIGID)
+	{
+		vector2d mass_center;
+		for (size_t i = 0; i < points.size (); i++)
+			mass_center += points[i].cur_pos * points[i].m;
+		mass_center = mass_center / mass;
+		for (size_t i = 0; i < points.size (); i++)
+			rest.push_back (points[i].cur_pos - mass_center);
+	}
+	else if (topology == TOPOLOGY_FULL)
+	{
+		for (size_t i = 0; i < points.size () - 3; i++)
+			for (size_t j = 0; j < points.size () - i - 2; j++)
+				poles.push_back (Pole (j, i + j + 2, (points[j].cur_pos - points[i + j + 2].cur_pos).len ()));
+	}
+	else
+	{
+		//central triangle and recursive splitting of arcs by their middle vertexes;
+		//triangles are well-shaped and any two vertexes are connected by O(log n) poles;
+		//second triangulation is turned by half of polygon and keeps triangles from flipping
+		size_t n = points.size ();
+		for (size_t offset = 0; offset < (n > 5 ? n : 1); offset += (n + 1) / 2)
+		{
+			size_t central[3] = {0, n / 3, 2 * n / 3};
+			for (size_t i = 0; i < 3; i++)
+			{
+				TriangulateArc (central[i], i < 2 ? central[i + 1] : n, offset);
+				size_t p1 = (central[i] + offset) % n, p2 = (central[(i + 1) % 3] + offset) % n;
+				size_t distance = (p2 + n - p1) % n;
+				if (distance > 1 && distance < n - 1)
+					poles.push_back (Pole (p1, p2, (points[p1].cur_pos - points[p2].cur_pos).len ()));
+			}
+		}
+	}
+}
+
+void DynamicBody::TriangulateArc (size_t first, size_t last, size_t offset)
+{
+	if (last - first < 2)
+		return;
+	size_t middle = (first + last) / 2;
+	TriangulateArc (first, middle, offset);
+	TriangulateArc (middle, last, offset);
+	//chord of arc is pole of triangle of outer arc; poles between adjacent vertexes are edges
+	size_t p1 = (first + offset) % points.size (), p2 = (middle + offset) % points.size (),
+		p3 = (last + offset) % points.size ();
+	if (middle - first > 1)
+		poles.push_back (Pole (p1, p2, (points[p1].cur_pos - points[p2].cur_pos).len ()));
+	if (last - middle > 1)
+		poles.push_back (Pole (p2, p3, (points[p2].cur_pos - points[p3].cur_pos).len ()));
 }
 
 void DynamicBody::AddDynamicPoint (Point point)
@@ -156,8 +423,41 @@ void DynamicBody::ProjectToAxis (vector2d axis, double *min, double *max)
 	}
 }
 
+void DynamicBody::MatchShape ()
+{
+	vector2d mass_center;
+	for (size_t i = 0; i < points.size (); i++)
+		mass_center += points[i].cur_pos * points[i].m;
+	mass_center = mass_center / mass;
+
+	//optimal rotation in 2d: angle of sum of weighted dot and cross products of rest and current offsets
+	double dot = 0.0, cross = 0.0;
+	for (size_t i = 0; i < points.size (); i++)
+	{
+		vector2d offset = points[i].cur_pos - mass_center;
+		dot += (rest[i] ^ offset) * points[i].m;
+		cross += (rest[i] * offset) * points[i].m;
+	}
+	double scale = sqrt (dot * dot + cross * cross);
+	if (scale < DBL_EPSILON)
+		return;
+	double cos_a = dot / scale, sin_a = cross / scale;
+
+	for (size_t i = 0; i < points.size (); i++)
+	{
+		vector2d goal = mass_center + vector2d (rest[i].x * cos_a - rest[i].y * sin_a,
+												rest[i].x * sin_a + rest[i].y * cos_a);
+		points[i].cur_pos += (goal - points[i].cur_pos) * stiffness;
+	}
+}
+
 void DynamicBody::UpdatePoles ()
 {
+	if (topology == TOPOLOGY_RIGID)
+	{
+		MatchShape ();
+		return;
+	}
 	//poles
 	for (size_t i = 0; i < poles.size (); i++)
 	{
@@ -185,274 +485,2030 @@ void DynamicBody::UpdatePoles ()
 		points[edges[i].p2].cur_pos += (goal2 - points[edges[i].p2].cur_pos) * stiffness;
 	}
 }
-//----------end of implementation of dynamic body-----------
 
-//----------implementation of physics-----------------------
-Physics::Physics (double timestep, vector2d gravity, BoundingBox world_size) :
-	t (timestep),
-	a (gravity),
-	world_box (world_size)
+/**
+@brief projects points of pole to its length with compliance
+@param alpha compliance of pole divided by square of timestep
+*/
+static void solve_pole (ArenaVector<Point> &points, Pole &pole, double alpha)
 {
+	vector2d d = points[pole.p2].cur_pos - points[pole.p1].cur_pos;
+	double length = d.len ();
+	if (length < DBL_EPSILON)
+		return;
+	double w1 = 1 / points[pole.p1].m, w2 = 1 / points[pole.p2].m;
+	double delta = (pole.len - length - alpha * pole.lambda) / (w1 + w2 + alpha);
+	pole.lambda += delta;
+	vector2d correction = d * (delta / length);
+	points[pole.p1].cur_pos -= correction * w1;
+	points[pole.p2].cur_pos += correction * w2;
 }
 
-size_t Physics::AddStaticBody (size_t points_num, ...)
+void DynamicBody::SolvePoles (double timestep, unsigned int iterations)
 {
-	if (points_num < 3)
-		log (LOG_FAIL, "Static body must have at least 3 vertices");
-	
-	log (LOG_INFO, "adding static body with %u points", points_num);
-
-	va_list valist;
-	va_start (valist, points_num);
-	StaticBodies.push_back (StaticBody ());
-	vector2d v1, v2;
-	v1 = va_arg (valist, vector2d);
-	v2 = va_arg (valist, vector2d);
-	StaticBodies.back().points.push_back (v1);
-	StaticBodies.back().points.push_back (v2);
-	
-	//calculate bbox by two vertices
-	if (v1.x < v2.x)
+	if (topology == TOPOLOGY_RIGID)
 	{
-		StaticBodies.back ().bbox.lb.x = v1.x;
-		StaticBodies.back ().bbox.rt.x = v2.x;
+		MatchShape ();
+		return;
 	}
-	else
+	for (size_t i = 0; i < poles.size (); i++)
+		poles[i].lambda = 0.0;
+	for (size_t i = 0; i < edges.size (); i++)
+		edges[i].lambda = 0.0;
+	double alpha = compliance / (timestep * timestep);
+	for (unsigned int k = 0; k < iterations; k++)
 	{
-		StaticBodies.back ().bbox.lb.x = v2.x;
-		StaticBodies.back ().bbox.rt.x = v1.x;
+		for (size_t i = 0; i < poles.size (); i++)
+			solve_pole (points, poles[i], alpha);
+		for (size_t i = 0; i < edges.size (); i++)
+			solve_pole (points, edges[i], alpha);
 	}
+}
+//----------end of implementation of dynamic body-----------
 
-	if (v1.y < v2.y)
-	{
-		StaticBodies.back ().bbox.lb.y = v1.y;
-		StaticBodies.back ().bbox.rt.y = v2.y;
-	}
-	else
+//----------implementation of lattice body------------------
+LatticeBody::LatticeBody (size_t columns, size_t rows, vector2d origin, double cell, double mass, double thickness) :
+	radius (thickness)
+{
+	if (columns < 2 || rows < 2)
+		log (LOG_FAIL, "lattice body must have at least 2 rows and 2 columns");
+	compliance[LATTICE_STRUCTURAL] = compliance[LATTICE_SHEAR] = compliance[LATTICE_BENDING] = 0.0;
+	for (size_t j = 0; j < rows; j++)
+		for (size_t i = 0; i < columns; i++)
+		{
+			points.push_back (Point (origin + vector2d (i * cell, j * cell), mass));
+			inv_mass.push_back (1 / mass);
+		}
+	//rows and columns are passed in order of points, so greedy choice of batch gives minimal number of batches
+	for (size_t j = 0; j < rows; j++)
+		for (size_t i = 0; i < columns; i++)
+		{
+			size_t p = j * columns + i;
+			if (i + 1 < columns)
+				AddConstraint (p, p + 1, LATTICE_STRUCTURAL);
+			if (j + 1 < rows)
+				AddConstraint (p, p + columns, LATTICE_STRUCTURAL);
+			if (i + 1 < columns && j + 1 < rows)
+			{
+				AddConstraint (p, p + columns + 1, LATTICE_SHEAR);
+				AddConstraint (p + 1, p + columns, LATTICE_SHEAR);
+			}
+			if (i + 2 < columns)
+				AddConstraint (p, p + 2, LATTICE_BENDING);
+			if (j + 2 < rows)
+				AddConstraint (p, p + 2 * columns, LATTICE_BENDING);
+		}
+	//outline: bottom row, right column, top row and left column
+	for (size_t i = 0; i + 1 < columns; i++)
+		boundary.push_back (i);
+	for (size_t j = 0; j + 1 < rows; j++)
+		boundary.push_back (j * columns + columns - 1);
+	for (size_t i = columns - 1; i > 0; i--)
+		boundary.push_back ((rows - 1) * columns + i);
+	for (size_t j = rows - 1; j > 0; j--)
+		boundary.push_back (j * columns);
+	RecalculateBBox ();
+}
+
+void LatticeBody::AddConstraint (size_t p1, size_t p2, LatticeConstraint kind)
+{
+	size_t batch = 0;
+	while (batch < batches.size () && (batches[batch].kind != kind || batches[batch].used[p1] || batches[batch].used[p2]))
+		batch++;
+	if (batch == batches.size ())
 	{
-		StaticBodies.back ().bbox.lb.y = v2.y;
-		StaticBodies.back ().bbox.rt.y = v1.y;
+		batches.push_back (ConstraintBatch ());
+		batches.back ().kind = kind;
 	}
+	ConstraintBatch &constraints = batches[batch];
+	constraints.used.resize (points.size (), false);
+	constraints.used[p1] = constraints.used[p2] = true;
+	constraints.first.push_back (p1);
+	constraints.second.push_back (p2);
+	constraints.length.push_back ((points[p2].cur_pos - points[p1].cur_pos).len ());
+	constraints.lambda.push_back (0.0);
+}
 
-	//adding the other points
-	for (size_t i = 2; i < points_num; i++)
-		StaticBodies.back().AddStaticPoint( va_arg (valist, vector2d));
+void LatticeBody::Pin (size_t point)
+{
+	inv_mass[point] = 0.0;
+	points[point].old_pos = points[point].cur_pos;
+}
 
-	va_end (valist);
-	return StaticBodies.size () - 1;
+void LatticeBody::SetCompliance (double structural, double shear, double bending)
+{
+	compliance[LATTICE_STRUCTURAL] = structural;
+	compliance[LATTICE_SHEAR] = shear;
+	compliance[LATTICE_BENDING] = bending;
 }
 
-size_t Physics::AddDynamicBody (double stiffness, size_t points_num, ...)
+void LatticeBody::SolveBatch (size_t batch, size_t begin, size_t end, double alpha)
 {
-	if (points_num < 3)
-		log (LOG_FAIL, "Dynamic body must have at least 3 verices");
+	ConstraintBatch &constraints = batches[batch];
+	for (size_t k = begin; k < end; k++)
+	{
+		size_t p1 = constraints.first[k], p2 = constraints.second[k];
+		double w1 = inv_mass[p1], w2 = inv_mass[p2];
+		vector2d d = points[p2].cur_pos - points[p1].cur_pos;
+		double length = d.len ();
+		if (length < DBL_EPSILON || w1 + w2 <= 0.0)
+			continue;
+		double delta = (constraints.length[k] - length - alpha * constraints.lambda[k]) / (w1 + w2 + alpha);
+		constraints.lambda[k] += delta;
+		vector2d correction = d * (delta / length);
+		points[p1].cur_pos -= correction * w1;
+		points[p2].cur_pos += correction * w2;
+	}
+}
 
-	log (LOG_INFO, "adding dynamic body with %u points", points_num);
+void LatticeBody::Solve (double timestep, unsigned int iterations)
+{
+	for (size_t b = 0; b < batches.size (); b++)
+		std::fill (batches[b].lambda.begin (), batches[b].lambda.end (), 0.0);
+	for (unsigned int k = 0; k < iterations; k++)
+		for (size_t b = 0; b < batches.size (); b++)
+			SolveBatch (b, 0, batches[b].first.size (), compliance[batches[b].kind] / (timestep * timestep));
+}
 
-	va_list valist;
-	va_start (valist, points_num);
-	DynamicBodies.push_back (DynamicBody (stiffness));
-	DynamicBodies.back ().points.push_back (va_arg (valist, Point));
-	DynamicBodies.back ().mass += DynamicBodies.back ().points.back ().m;
-	DynamicBodies.back ().points.push_back (va_arg (valist, Point));
-	DynamicBodies.back ().mass += DynamicBodies.back ().points.back ().m;
+void LatticeBody::RecalculateBBox ()
+{
+	bbox.lb = bbox.rt = points[0].cur_pos;
+	for (size_t i = 1; i < points.size (); i++)
+		bbox.Expand (points[i].cur_pos);
+	bbox.lb -= vector2d (radius, radius);
+	bbox.rt += vector2d (radius, radius);
+}
 
-	for (size_t i = 2; i < points_num; i++)
-		DynamicBodies.back ().AddDynamicPoint (va_arg (valist, Point));
+size_t LatticeBody::Memory () const
+{
+	size_t bytes = points.capacity () * sizeof (Point) + inv_mass.capacity () * sizeof (double) +
+		batches.capacity () * sizeof (ConstraintBatch) + boundary.capacity () * sizeof (size_t);
+	for (size_t b = 0; b < batches.size (); b++)
+		bytes += (batches[b].first.capacity () + batches[b].second.capacity ()) * sizeof (size_t) +
+			(batches[b].length.capacity () + batches[b].lambda.capacity ()) * sizeof (double) + batches[b].used.capacity () / 8;
+	return bytes;
+}
+//----------end of implementation of lattice body-----------
 
-	va_end (valist);
-	DynamicBodies.back ().RecalculateBBox ();
-	DynamicBodies.back ().CalculateEdges ();
-	return DynamicBodies.size () - 1;
+//----------implementation of rope--------------------------
+Rope::Rope (vector2d start, vector2d end, size_t links, double mass, double thickness) :
+	compliance (0.0),
+	radius (thickness)
+{
+	if (!links)
+		log (LOG_FAIL, "rope must have at least 1 link");
+	for (size_t i = 0; i <= links; i++)
+	{
+		points.push_back (Point (start + (end - start) * ((double)i / links), mass));
+		inv_mass.push_back (1 / mass);
+	}
+	for (size_t k = 0; k < links; k++)
+		length.push_back ((points[k + 1].cur_pos - points[k].cur_pos).len ());
+	direction.resize (links);
+	lambda.resize (links);
+	upper.resize (links);
+	rhs.resize (links);
+	RecalculateBBox ();
+}
+
+void Rope::Pin (size_t point)
+{
+	inv_mass[point] = 0.0;
+	points[point].old_pos = points[point].cur_pos;
 }
 
-bool Physics::isDynamicDynamic (size_t first, size_t second)
+void Rope::Solve (double timestep, unsigned int iterations)
 {
-	size_t vertex_body = 0;
-	info.depth = DBL_MAX;
-	for (size_t i = 0; i < DynamicBodies[first].edges.size () + DynamicBodies[second].edges.size (); i++)
+	size_t links = length.size ();
+	double alpha = compliance / (timestep * timestep);
+	std::fill (lambda.begin (), lambda.end (), 0.0);
+	for (unsigned int iteration = 0; iteration < iterations; iteration++)
 	{
-		Edge edge;
-		if (i < DynamicBodies[first].edges.size ())
+		//changes of multipliers are found from (J M^-1 J^T + alpha) delta = -C - alpha lambda, J - gradient of lengths;
+		//neighbor links share one point, so matrix is tridiagonal
+		for (size_t k = 0; k < links; k++)
 		{
-			edge.p1 = DynamicBodies[first].points.begin () + DynamicBodies[first].edges[i].p1;
-			edge.p2 = DynamicBodies[first].points.begin () + DynamicBodies[first].edges[i].p2;
+			vector2d d = points[k + 1].cur_pos - points[k].cur_pos;
+			double distance = d.len ();
+			direction[k] = distance > DBL_EPSILON ? d / distance : vector2d (0.0, 0.0);
+			rhs[k] = length[k] - distance - alpha * lambda[k];
 		}
-		else
+		//forward sweep of Thomas algorithm; matrix is diagonally dominant, so it's stable without pivoting
+		for (size_t k = 0; k < links; k++)
 		{
-			edge.p1 = DynamicBodies[second].points.begin () + 
-				DynamicBodies[second].edges[i - DynamicBodies[first].edges.size ()].p1;
-			edge.p2 = DynamicBodies[second].points.begin () +
-				DynamicBodies[second].edges[i - DynamicBodies[first].edges.size ()].p2;
+			double diagonal = inv_mass[k] + inv_mass[k + 1] + alpha;
+			//link between pinned points can't be changed
+			if (diagonal <= 0.0)
+			{
+				diagonal = 1.0;
+				rhs[k] = 0.0;
+			}
+			if (k > 0)
+			{
+				double lower = -inv_mass[k] * (direction[k - 1] ^ direction[k]);
+				diagonal -= lower * upper[k - 1];
+				rhs[k] -= lower * rhs[k - 1];
+			}
+			upper[k] = k + 1 < links ? -inv_mass[k + 1] * (direction[k] ^ direction[k + 1]) / diagonal : 0.0;
+			rhs[k] /= diagonal;
 		}
-
-		vector2d axis (edge.p2->cur_pos.y - edge.p1->cur_pos.y,
-					   edge.p1->cur_pos.x - edge.p2->cur_pos.x);
-		axis = axis.norm ();
-
-		double first_min, first_max, second_min, second_max;
-		DynamicBodies[first].ProjectToAxis (axis, &first_min, &first_max);
-		DynamicBodies[second].ProjectToAxis (axis, &second_min, &second_max);
-
-		double distance = (first_min < second_min) ? second_min - first_max : first_min - second_max;
-
-		if (distance > -DBL_MIN)
-			return false;
-		else if (abs (distance) < info.depth)
+		for (size_t k = links - 1; k-- > 0;)
+			rhs[k] -= upper[k] * rhs[k + 1];
+		for (size_t k = 0; k < links; k++)
 		{
-			info.depth = -distance;
-			info.normal = axis;
-			info.edge = edge;
-			vertex_body = (i < DynamicBodies[first].edges.size ()) ? second : first;
+			lambda[k] += rhs[k];
+			vector2d correction = direction[k] * rhs[k];
+			points[k].cur_pos -= correction * inv_mass[k];
+			points[k + 1].cur_pos += correction * inv_mass[k + 1];
 		}
 	}
-	info.point = DynamicBodies[vertex_body].points.begin ();
-	for (size_t i = 1; i < DynamicBodies[vertex_body].points.size (); i++)
-		if ((info.normal ^ DynamicBodies[vertex_body].points[i].cur_pos) < (info.normal ^ info.point->cur_pos))
-			info.point = DynamicBodies[vertex_body].points.begin () + i;
-	info.point_body = vertex_body;
-	info.edge_body = first + second - vertex_body;
-	return true;
 }
 
-bool Physics::isDynamicStatic (size_t dynamic_body, size_t static_body)
+void Rope::RecalculateBBox ()
 {
-	info.depth = DBL_MAX;
-	info.is_point = false;
-	//edges of dynamic body
-	for (size_t i = 0; i < DynamicBodies[dynamic_body].edges.size (); i++)
-	{
-		Edge edge;
-		edge.p1 = DynamicBodies[dynamic_body].points.begin () + DynamicBodies[dynamic_body].edges[i].p1;
-		edge.p2 = DynamicBodies[dynamic_body].points.begin () + DynamicBodies[dynamic_body].edges[i].p2;
+	bbox.lb = bbox.rt = points[0].cur_pos;
+	for (size_t i = 1; i < points.size (); i++)
+		bbox.Expand (points[i].cur_pos);
+	bbox.lb -= vector2d (radius, radius);
+	bbox.rt += vector2d (radius, radius);
+}
 
-		vector2d axis (edge.p2->cur_pos.y - edge.p1->cur_pos.y,
-					   edge.p1->cur_pos.x - edge.p2->cur_pos.x);
-		axis = axis.norm ();
+size_t Rope::Memory () const
+{
+	return points.capacity () * sizeof (Point) + direction.capacity () * sizeof (vector2d) +
+		(inv_mass.capacity () + length.capacity () + lambda.capacity () + upper.capacity () + rhs.capacity ()) * sizeof (double);
+}
+//----------end of implementation of rope-------------------
 
-		double first_min, first_max, second_min, second_max;
-		DynamicBodies[dynamic_body].ProjectToAxis (axis, &first_min, &first_max);
-		StaticBodies[static_body].ProjectToAxis (axis, &second_min, &second_max);
+//----------implementation of contact-----------------------
+Contact::Contact (size_t first_body, size_t second_body, bool static_pair) :
+	first (first_body),
+	second (second_body),
+	is_static (static_pair),
+	accumulated (0.0)
+{
+}
 
-		double distance = (first_min < second_min) ? second_min - first_max : first_min - second_max;
+bool Contact::operator< (const Contact &b) const
+{
+	if (first != b.first)
+		return first < b.first;
+	if (is_static != b.is_static)
+		return b.is_static;
+	return second < b.second;
+}
 
-		if (distance > -DBL_MIN)
-			return false;
-		else if (abs (distance) < info.depth)
-		{
-			info.depth = -distance;
-			info.normal = (second_max > first_max) ? axis : axis * (-1);;
-			info.edge = edge;
-		}
-	}
-	//edges of static body
-	for (size_t i = 0; i < StaticBodies[static_body].points.size (); i++)
-	{
-		vector2d p1 = StaticBodies[static_body].points[i],
-			p2 = StaticBodies[static_body].points[(i + 1) % StaticBodies[static_body].points.size ()];
+bool Contact::SameFeature (const Contact &b) const
+{
+	if (info.is_point != b.info.is_point || info.point_body != b.info.point_body)
+		return false;
+	if (info.is_point)
+		return info.point == b.info.point;
+	if (info.edge_p1 != b.info.edge_p1 || info.edge_p2 != b.info.edge_p2)
+		return false;
+	if (is_static)
+		return info.static_point.x == b.info.static_point.x && info.static_point.y == b.info.static_point.y;
+	return info.point == b.info.point;
+}
+//----------end of implementation of contact----------------
 
-		vector2d axis (p2.y - p1.y, p1.x - p2.x);
-		axis = axis.norm ();
+//----------implementation of physics-----------------------
+Physics::Physics (double timestep, vector2d gravity, BoundingBox world_size, std::shared_ptr<StaticGeometry> statics) :
+	static_geometry (statics ? statics : std::make_shared<StaticGeometry> ()),
+	t (timestep),
+	a (gravity),
+	world_box (world_size),
+	warm_start (1.0),
+	ccd_threshold (0.05),
+	ccd (true),
+	static_tree (static_geometry->tree),
+	fat_margin (0.01),
+	max_radius (0.0),
+	reorder_period (0),
+	steps_since_reorder (0),
+	mutual_gravity (false),
+	gravity_constant (1.0),
+	gravity_theta (0.5),
+	gravity_softening (0.01),
+	substeps (1),
+	constraint_iterations (1),
+	tier_distance (1.0),
+	tiers (0),
+	step_index (0),
+	allocation_check (false),
+	StaticBodies (static_geometry->bodies),
+	Terrains (static_geometry->terrains)
+{
+}
 
-		double first_min, first_max, second_min, second_max;
-		DynamicBodies[dynamic_body].ProjectToAxis (axis, &first_min, &first_max);
-		StaticBodies[static_body].ProjectToAxis (axis, &second_min, &second_max);
+void Physics::RefitProxy (size_t dynamic_body)
+{
+	DynamicBody &body = DynamicBodies[dynamic_body];
+	if (body.proxy != AABBTree::null)
+	{
+		BoundingBox box = dynamic_tree.GetBox (body.proxy);
+		if (box.Contains (body.bbox.lb) && box.Contains (body.bbox.rt))
+			return;
+	}
+	BoundingBox fat (body.bbox.lb - vector2d (fat_margin, fat_margin), body.bbox.rt + vector2d (fat_margin, fat_margin));
+	if (body.proxy == AABBTree::null)
+		body.proxy = dynamic_tree.CreateProxy (fat, dynamic_body);
+	else
+		dynamic_tree.MoveProxy (body.proxy, fat);
+}
 
-		double distance = (first_min < second_min) ? second_min - first_max : first_min - second_max;
+void Physics::DestroyDynamicBody (size_t dynamic_body)
+{
+	if (DynamicBodies[dynamic_body].proxy != AABBTree::null)
+		dynamic_tree.DestroyProxy (DynamicBodies[dynamic_body].proxy);
+	size_t slot = DynamicBodies[dynamic_body].handle & handle_slot_mask;
+	handle_index[slot] = AABBTree::null;
+	handle_generation[slot]++;
+	free_handles.push_back (slot);
+	if (dynamic_body != DynamicBodies.size () - 1)
+	{
+		DynamicBodies[dynamic_body] = std::move (DynamicBodies.back ());
+		if (DynamicBodies[dynamic_body].proxy != AABBTree::null)
+			dynamic_tree.SetData (DynamicBodies[dynamic_body].proxy, dynamic_body);
+		handle_index[DynamicBodies[dynamic_body].handle & handle_slot_mask] = dynamic_body;
+	}
+	DynamicBodies.pop_back ();
 
-		if (distance > -DBL_MIN)
-			return false;
-		else if (abs (distance) < info.depth)
+	//contacts of destroyed body are dropped; the last body took its index
+	size_t last = DynamicBodies.size (), kept = 0;
+	bool moved = false;
+	for (size_t k = 0; k < contact_cache.size (); k++)
+	{
+		Contact contact = contact_cache[k];
+		if (contact.first == dynamic_body || (!contact.is_static && contact.second == dynamic_body))
+			continue;
+		if (contact.first == last || (!contact.is_static && contact.second == last))
 		{
-			info.depth = -distance;
-			info.normal = (first_max > second_max)? axis : axis * (-1);
-			info.is_point = true;
+			moved = true;
+			if (contact.first == last)
+				contact.first = dynamic_body;
+			if (!contact.is_static && contact.second == last)
+				contact.second = dynamic_body;
+			//first body of dynamic pair has the smaller index
+			if (!contact.is_static && contact.second < contact.first)
+				std::swap (contact.first, contact.second);
+			if (contact.info.edge_body == last)
+				contact.info.edge_body = dynamic_body;
+			if (contact.info.point_body == last)
+				contact.info.point_body = dynamic_body;
 		}
+		contact_cache[kept++] = contact;
 	}
+	contact_cache.resize (kept, Contact (0, 0, false));
+	if (moved)
+		std::sort (contact_cache.begin (), contact_cache.end ());
+	log (LOG_INFO, "dynamic body destroyed");
+}
 
-	if (info.is_point)
+void Physics::CreateHandle (size_t dynamic_body)
+{
+	size_t slot;
+	if (free_handles.empty ())
 	{
-		info.point = DynamicBodies[dynamic_body].points.begin ();
-		for (size_t i = 1; i < DynamicBodies[dynamic_body].points.size (); i++)
-			if ((info.normal ^ DynamicBodies[dynamic_body].points[i].cur_pos) < (info.normal ^ info.point->cur_pos))
-				info.point = DynamicBodies[dynamic_body].points.begin () + i;
+		slot = handle_index.size ();
+		handle_index.push_back (dynamic_body);
+		handle_generation.push_back (0);
 	}
 	else
 	{
-		info.static_point = StaticBodies[static_body].points[0];
-		for (size_t i = 1; i < StaticBodies[static_body].points.size (); i++)
-			if ((info.normal ^ StaticBodies[static_body].points[i]) < (info.normal ^ info.static_point))
-				info.static_point = StaticBodies[static_body].points[i];
+		slot = free_handles.back ();
+		free_handles.pop_back ();
+		handle_index[slot] = dynamic_body;
 	}
+	DynamicBodies[dynamic_body].handle = (handle_generation[slot] << handle_shift) | slot;
+}
+
+bool Physics::FindBody (size_t handle, size_t *dynamic_body)
+{
+	size_t slot = handle & handle_slot_mask;
+	if (slot >= handle_index.size () || handle_index[slot] == AABBTree::null ||
+		(handle_generation[slot] << handle_shift) != (handle & ~handle_slot_mask))
+		return false;
+	*dynamic_body = handle_index[slot];
 	return true;
 }
 
-void Physics::Update (unsigned int iterations)
+/**
+@brief adds bytes to FNV-1a hash
+*/
+static unsigned long long hash_bytes (unsigned long long hash, const void *data, size_t size)
+{
+	const unsigned char *bytes = (const unsigned char *)data;
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	return hash;
+}
+
+unsigned long long Physics::StateHash ()
 {
-	//1st step: integration
+	unsigned long long hash = 14695981039346656037ULL;
+	size_t size = DynamicBodies.size ();
+	hash = hash_bytes (hash, &size, sizeof (size));
 	for (size_t i = 0; i < DynamicBodies.size (); i++)
 	{
-		for (size_t j = 0; j < DynamicBodies[i].points.size (); j++)
-			DynamicBodies[i].points[j].Update (t, a);
-
-		DynamicBodies[i].UpdatePoles ();
-
-		DynamicBodies[i].RecalculateBBox ();
-		if (!(DynamicBodies[i].bbox * world_box))
+		ArenaVector<Point> &points = DynamicBodies[i].points;
+		hash = hash_bytes (hash, &DynamicBodies[i].handle, sizeof (size_t));
+		for (size_t j = 0; j < points.size (); j++)
 		{
-			DynamicBodies.erase (DynamicBodies.begin () + i);
-			log (LOG_INFO, "dynamic body destroyed");
+			hash = hash_bytes (hash, &points[j].cur_pos, sizeof (vector2d));
+			hash = hash_bytes (hash, &points[j].old_pos, sizeof (vector2d));
 		}
 	}
-
-	//2nd step: collision detection
-	for (unsigned int cur_iteration = 0; cur_iteration < iterations; cur_iteration++)
+	size = Particles.size ();
+	hash = hash_bytes (hash, &size, sizeof (size));
+	for (size_t i = 0; i < Particles.size (); i++)
+	{
+		hash = hash_bytes (hash, &Particles[i].cur_pos, sizeof (vector2d));
+		hash = hash_bytes (hash, &Particles[i].old_pos, sizeof (vector2d));
+	}
+	for (size_t i = 0; i < LatticeBodies.size () + Ropes.size (); i++)
 	{
-		for (size_t i = 0; i < DynamicBodies.size (); i++)
+		std::vector<Point> &points = i < LatticeBodies.size () ? LatticeBodies[i].points : Ropes[i - LatticeBodies.size ()].points;
+		for (size_t j = 0; j < points.size (); j++)
 		{
-			//dynamic - dynamic
-			for (size_t j = i + 1; j < DynamicBodies.size (); j++)
-				if (DynamicBodies[i].bbox * DynamicBodies[j].bbox)
-					if (isDynamicDynamic (i, j))
-					{
-						// collision responce
-						double sum_mass = DynamicBodies[info.edge_body].mass + DynamicBodies[info.point_body].mass;
-						if (info.depth > max_depth)
-							info.depth = max_depth;
-						info.point->cur_pos += info.normal * info.depth * (DynamicBodies[info.edge_body].mass / sum_mass);
-
-						double t = (info.point->cur_pos - info.edge.p1->cur_pos).len () * info.edge.p1->m /
-							((info.point->cur_pos - info.edge.p1->cur_pos).len () * info.edge.p1->m +
-							 (info.point->cur_pos - info.edge.p2->cur_pos).len () * info.edge.p2->m);
-						double lambda = 1.0 / (t * t + (1 - t) * (1 - t));
-						info.edge.p1->cur_pos -= info.normal * info.depth * (1 - t) * 0.5 * lambda;
-						info.edge.p2->cur_pos -= info.normal * info.depth * t * 0.5 * lambda;
-
-						DynamicBodies[i].RecalculateBBox ();
-						DynamicBodies[j].RecalculateBBox ();
-					}
-			//dynamic - static
-			for (size_t j = 0; j < StaticBodies.size (); j++)
-				if (DynamicBodies[i].bbox * StaticBodies[j].bbox)
-					if (isDynamicStatic (i, j))
+			hash = hash_bytes (hash, &points[j].cur_pos, sizeof (vector2d));
+			hash = hash_bytes (hash, &points[j].old_pos, sizeof (vector2d));
+		}
+	}
+	//cached contacts warm-start the next step, so they are part of state
+	size = contact_cache.size ();
+	hash = hash_bytes (hash, &size, sizeof (size));
+	for (size_t i = 0; i < contact_cache.size (); i++)
+	{
+		hash = hash_bytes (hash, &contact_cache[i].first, sizeof (size_t));
+		hash = hash_bytes (hash, &contact_cache[i].second, sizeof (size_t));
+		hash = hash_bytes (hash, &contact_cache[i].accumulated, sizeof (double));
+	}
+	return hash;
+}
+
+void Physics::SetReordering (unsigned int period)
+{
+	reorder_period = period;
+	steps_since_reorder = 0;
+}
+
+/**
+@brief interleaves bits of coordinates
+@param x, y coordinates; only lower 16 bits are used
+@return code of point on Z-order curve
+*/
+static unsigned int MortonCode (unsigned int x, unsigned int y)
+{
+	//spreads 16 bits to even positions
+	x = (x | (x << 8)) & 0x00FF00FF;
+	x = (x | (x << 4)) & 0x0F0F0F0F;
+	x = (x | (x << 2)) & 0x33333333;
+	x = (x | (x << 1)) & 0x55555555;
+	y = (y | (y << 8)) & 0x00FF00FF;
+	y = (y | (y << 4)) & 0x0F0F0F0F;
+	y = (y | (y << 2)) & 0x33333333;
+	y = (y | (y << 1)) & 0x55555555;
+	return x | (y << 1);
+}
+
+/**
+@brief code of position inside of world on Z-order curve
+*/
+static unsigned int MortonCode (vector2d position, BoundingBox world)
+{
+	double x = (position.x - world.lb.x) / (world.rt.x - world.lb.x);
+	double y = (position.y - world.lb.y) / (world.rt.y - world.lb.y);
+	x = std::min (std::max (x, 0.0), 1.0);
+	y = std::min (std::max (y, 0.0), 1.0);
+	return MortonCode ((unsigned int)(x * 65535.0), (unsigned int)(y * 65535.0));
+}
+
+void Physics::ReorderBodies ()
+{
+	reorder_keys.clear ();
+	for (size_t i = 0; i < DynamicBodies.size (); i++)
+	{
+		BoundingBox &bbox = DynamicBodies[i].bbox;
+		reorder_keys.push_back (std::make_pair (MortonCode ((bbox.lb + bbox.rt) * 0.5, world_box), i));
+	}
+	std::sort (reorder_keys.begin (), reorder_keys.end ());
+	new_index.resize (DynamicBodies.size ());
+	reorder_buffer.clear ();
+	for (size_t k = 0; k < reorder_keys.size (); k++)
+	{
+		size_t i = reorder_keys[k].second;
+		new_index[i] = k;
+		reorder_buffer.push_back (std::move (DynamicBodies[i]));
+		DynamicBody &body = reorder_buffer.back ();
+		if (body.proxy != AABBTree::null)
+			dynamic_tree.SetData (body.proxy, k);
+		handle_index[body.handle & handle_slot_mask] = k;
+	}
+	DynamicBodies.swap (reorder_buffer);
+	reorder_buffer.clear ();
+
+	//cached contacts keep pairs ordered by their new indexes
+	for (size_t k = 0; k < contact_cache.size (); k++)
+	{
+		Contact &contact = contact_cache[k];
+		contact.first = new_index[contact.first];
+		if (!contact.is_static)
+		{
+			//first body of dynamic pair has the smaller index
+			contact.second = new_index[contact.second];
+			if (contact.second < contact.first)
+				std::swap (contact.first, contact.second);
+		}
+		contact.info.edge_body = new_index[contact.info.edge_body];
+		contact.info.point_body = new_index[contact.info.point_body];
+	}
+	std::sort (contact_cache.begin (), contact_cache.end ());
+
+	reorder_keys.clear ();
+	for (size_t i = 0; i < Particles.size (); i++)
+		reorder_keys.push_back (std::make_pair (MortonCode (Particles[i].cur_pos, world_box), i));
+	std::sort (reorder_keys.begin (), reorder_keys.end ());
+	particle_buffer.clear ();
+	for (size_t k = 0; k < reorder_keys.size (); k++)
+		particle_buffer.push_back (Particles[reorder_keys[k].second]);
+	Particles.swap (particle_buffer);
+}
+
+void Physics::QueryBodies (BoundingBox box, std::vector<size_t> *static_bodies, std::vector<size_t> *dynamic_bodies)
+{
+	if (static_bodies)
+		static_tree.Query (box, [static_bodies] (size_t i) { static_bodies->push_back (i); return true; });
+	if (dynamic_bodies)
+		dynamic_tree.Query (box, [dynamic_bodies] (size_t i) { dynamic_bodies->push_back (i); return true; });
+}
+
+void Physics::SetCollisionFilter (const std::vector<size_t> &static_bodies, const std::vector<size_t> &dynamic_bodies,
+								  CollisionFilter filter)
+{
+	for (size_t i = 0; i < static_bodies.size (); i++)
+		StaticBodies[static_bodies[i]].filter = filter;
+	for (size_t i = 0; i < dynamic_bodies.size (); i++)
+		DynamicBodies[dynamic_bodies[i]].filter = filter;
+}
+
+void Physics::QueryPoint (vector2d point, std::vector<size_t> *static_bodies, std::vector<size_t> *dynamic_bodies)
+{
+	BoundingBox box (point, point);
+	vector2d normal;
+	double depth;
+	size_t edge;
+	if (static_bodies)
+		static_tree.Query (box, [&] (size_t i)
+		{
+			std::vector<vector2d> &points = StaticBodies[i].points;
+			if (CircleConvex (point, 0.0, points.size (), [&points] (size_t k) { return points[k]; }, &normal, &depth, &edge))
+				static_bodies->push_back (i);
+			return true;
+		});
+	if (dynamic_bodies)
+		dynamic_tree.Query (box, [&] (size_t i)
+		{
+			ArenaVector<Point> &points = DynamicBodies[i].points;
+			if (CircleConvex (point, 0.0, points.size (), [&points] (size_t k) { return points[k].cur_pos; },
+							  &normal, &depth, &edge))
+				dynamic_bodies->push_back (i);
+			return true;
+		});
+}
+
+bool Physics::FindNearestPoint (vector2d position, double radius, size_t *body, size_t *point)
+{
+	double min_sqr_len = radius * radius;
+	bool found = false;
+	dynamic_tree.Query (BoundingBox (position - vector2d (radius, radius), position + vector2d (radius, radius)),
+						[&] (size_t i)
+	{
+		for (size_t j = 0; j < DynamicBodies[i].points.size (); j++)
+		{
+			double sqr_len = (DynamicBodies[i].points[j].cur_pos - position).sqr_len ();
+			if (sqr_len < min_sqr_len)
+			{
+				min_sqr_len = sqr_len;
+				*body = i;
+				*point = j;
+				found = true;
+			}
+		}
+		return true;
+	});
+	return found;
+}
+
+bool Physics::RayCast (Ray ray, RayHit *hit)
+{
+	hit->hit = false;
+	hit->fraction = 1.0;
+	static_tree.RayCast (ray.from, ray.to, [&] (size_t i, double max_fraction)
+	{
+		std::vector<vector2d> &points = StaticBodies[i].points;
+		double enter;
+		vector2d normal;
+		if (SegmentConvex (ray.from, ray.to, points.size (), [&points] (size_t k) { return points[k]; }, &enter, &normal) &&
+			enter < max_fraction)
+		{
+			hit->hit = hit->is_static = true;
+			hit->body = i;
+			hit->fraction = enter;
+			hit->normal = normal;
+			return enter;
+		}
+		return max_fraction;
+	});
+	//dynamic bodies are checked only on the part of segment before static hit
+	double limit = hit->fraction;
+	if (limit > 0.0)
+		dynamic_tree.RayCast (ray.from, ray.from + (ray.to - ray.from) * limit, [&] (size_t i, double max_fraction)
+		{
+			ArenaVector<Point> &points = DynamicBodies[i].points;
+			double enter;
+			vector2d normal;
+			if (SegmentConvex (ray.from, ray.to, points.size (), [&points] (size_t k) { return points[k].cur_pos; },
+							   &enter, &normal) && enter < hit->fraction)
+			{
+				hit->hit = true;
+				hit->is_static = false;
+				hit->body = i;
+				hit->fraction = enter;
+				hit->normal = normal;
+				//fraction of clipped segment
+				return enter / limit;
+			}
+			return max_fraction;
+		});
+	hit->point = ray.from + (ray.to - ray.from) * hit->fraction;
+	return hit->hit;
+}
+
+void Physics::RayCast (const std::vector<Ray> &rays, std::vector<RayHit> *hits)
+{
+	hits->resize (rays.size ());
+	if (!pool)
+	{
+		for (size_t i = 0; i < rays.size (); i++)
+			RayCast (rays[i], &(*hits)[i]);
+		return;
+	}
+	//every task casts contiguous range of rays; queries don't modify world
+	for (size_t begin = 0; begin < rays.size (); begin += chunk_rays)
+	{
+		size_t end = std::min (rays.size (), begin + chunk_rays);
+		pool->Submit ([this, &rays, hits, begin, end] ()
+		{
+			for (size_t i = begin; i < end; i++)
+				RayCast (rays[i], &(*hits)[i]);
+		});
+	}
+	pool->Wait ();
+}
+
+void Physics::SetContinuousCollision (bool enabled, double min_displacement)
+{
+	ccd = enabled;
+	ccd_threshold = min_displacement;
+}
+
+void Physics::SetBroadPhaseMargin (double margin)
+{
+	fat_margin = margin;
+}
+
+size_t Physics::AddParticle (vector2d position, double radius, double mass)
+{
+	AllocationPhase phase ("particles");
+	Particles.push_back (Particle (position, radius, mass));
+	if (radius > max_radius)
+		max_radius = radius;
+	return Particles.size () - 1;
+}
+
+size_t Physics::AddLatticeBody (size_t columns, size_t rows, vector2d origin, double cell, double mass, double thickness)
+{
+	log (LOG_INFO, "adding lattice body with %u x %u points", columns, rows);
+	AllocationPhase phase ("lattice bodies");
+	LatticeBodies.push_back (LatticeBody (columns, rows, origin, cell, mass, thickness));
+	return LatticeBodies.size () - 1;
+}
+
+size_t Physics::AddRope (vector2d start, vector2d end, size_t links, double mass, double thickness)
+{
+	log (LOG_INFO, "adding rope with %u links", links);
+	AllocationPhase phase ("ropes");
+	Ropes.push_back (Rope (start, end, links, mass, thickness));
+	return Ropes.size () - 1;
+}
+
+void Physics::SetWarmStarting (double factor)
+{
+	warm_start = factor;
+}
+
+size_t Physics::AddStaticBody (size_t points_num, ...)
+{
+	if (points_num < 3)
+		log (LOG_FAIL, "Static body must have at least 3 vertices");
+	
+	log (LOG_INFO, "adding static body with %u points", points_num);
+	AllocationPhase phase ("static bodies");
+
+	va_list valist;
+	va_start (valist, points_num);
+	StaticBodies.push_back (StaticBody ());
+	vector2d v1, v2;
+	v1 = va_arg (valist, vector2d);
+	v2 = va_arg (valist, vector2d);
+	StaticBodies.back().points.push_back (v1);
+	StaticBodies.back().points.push_back (v2);
+	
+	//calculate bbox by two vertices
+	if (v1.x < v2.x)
+	{
+		StaticBodies.back ().bbox.lb.x = v1.x;
+		StaticBodies.back ().bbox.rt.x = v2.x;
+	}
+	else
+	{
+		StaticBodies.back ().bbox.lb.x = v2.x;
+		StaticBodies.back ().bbox.rt.x = v1.x;
+	}
+
+	if (v1.y < v2.y)
+	{
+		StaticBodies.back ().bbox.lb.y = v1.y;
+		StaticBodies.back ().bbox.rt.y = v2.y;
+	}
+	else
+	{
+		StaticBodies.back ().bbox.lb.y = v2.y;
+		StaticBodies.back ().bbox.rt.y = v1.y;
+	}
+
+	//adding the other points
+	for (size_t i = 2; i < points_num; i++)
+		StaticBodies.back().AddStaticPoint( va_arg (valist, vector2d));
+
+	va_end (valist);
+	return StaticBodies.size () - 1;
+}
+
+size_t Physics::AddStaticBody (const std::vector<vector2d> &points)
+{
+	if (points.size () < 3)
+		log (LOG_FAIL, "Static body must have at least 3 vertices");
+
+	log (LOG_INFO, "adding static body with %u points", points.size ());
+	AllocationPhase phase ("static bodies");
+	StaticBodies.push_back (StaticBody ());
+	StaticBody &body = StaticBodies.back ();
+	body.points = points;
+	for (size_t i = 0; i < points.size (); i++)
+		body.bbox.Expand (points[i]);
+	return StaticBodies.size () - 1;
+}
+
+size_t Physics::AddTerrain (const std::vector<vector2d> &points)
+{
+	log (LOG_INFO, "adding terrain with %u points", points.size ());
+	AllocationPhase phase ("terrains");
+	Terrains.push_back (Terrain (points));
+	return Terrains.size () - 1;
+}
+
+size_t Physics::AddTerrain (double x0, double step, const std::vector<double> &heights)
+{
+	log (LOG_INFO, "adding heightfield with %u samples", heights.size ());
+	AllocationPhase phase ("terrains");
+	Terrains.push_back (Terrain (x0, step, heights));
+	return Terrains.size () - 1;
+}
+
+size_t Physics::AddDynamicBody (double stiffness, size_t points_num, ...)
+{
+	if (points_num < 3)
+		log (LOG_FAIL, "Dynamic body must have at least 3 verices");
+
+	log (LOG_INFO, "adding dynamic body with %u points", points_num);
+	AllocationPhase phase ("dynamic bodies");
+
+	va_list valist;
+	va_start (valist, points_num);
+	DynamicBodies.push_back (DynamicBody (stiffness, &arena));
+	DynamicBodies.back ().points.push_back (va_arg (valist, Point));
+	DynamicBodies.back ().mass += DynamicBodies.back ().points.back ().m;
+	DynamicBodies.back ().points.push_back (va_arg (valist, Point));
+	DynamicBodies.back ().mass += DynamicBodies.back ().points.back ().m;
+
+	for (size_t i = 2; i < points_num; i++)
+		DynamicBodies.back ().AddDynamicPoint (va_arg (valist, Point));
+
+	va_end (valist);
+	DynamicBodies.back ().RecalculateBBox ();
+	DynamicBodies.back ().CalculateEdges ();
+	CreateHandle (DynamicBodies.size () - 1);
+	return DynamicBodies.size () - 1;
+}
+
+/**
+@brief compares points by x, then by y coordinate
+*/
+static bool PointLess (const Point &a, const Point &b)
+{
+	return a.cur_pos.x < b.cur_pos.x || (a.cur_pos.x == b.cur_pos.x && a.cur_pos.y < b.cur_pos.y);
+}
+
+size_t Physics::AddDynamicBody (double stiffness, std::vector<Point> points, Topology topology)
+{
+	if (points.size () < 3)
+		log (LOG_FAIL, "Dynamic body must have at least 3 vertices");
+	log (LOG_INFO, "adding dynamic body with hull of %u points", points.size ());
+	AllocationPhase phase ("dynamic bodies");
+
+	//monotone chain; hull is counter-clockwise like after AddDynamicPoint
+	std::sort (points.begin (), points.end (), PointLess);
+	DynamicBodies.push_back (DynamicBody (stiffness, &arena, topology));
+	DynamicBody &body = DynamicBodies.back ();
+	//hull is built right in memory of body
+	ArenaVector<Point> &hull = body.points;
+	hull.reserve (points.size () + 1);
+	for (size_t pass = 0; pass < 2; pass++)
+	{
+		size_t chain_start = hull.size ();
+		for (size_t k = 0; k < points.size (); k++)
+		{
+			Point &p = points[pass ? points.size () - 1 - k : k];
+			while (hull.size () >= chain_start + 2 &&
+				   ((hull[hull.size () - 1].cur_pos - hull[hull.size () - 2].cur_pos) *
+					(p.cur_pos - hull[hull.size () - 2].cur_pos)) < DBL_EPSILON)
+				hull.pop_back ();
+			hull.push_back (p);
+		}
+		//last point of chain is the first point of the other chain
+		hull.pop_back ();
+	}
+	if (hull.size () < 3)
+		log (LOG_FAIL, "Dynamic body must have at least 3 vertices that are not collinear");
+
+	for (size_t i = 0; i < body.points.size (); i++)
+		body.mass += body.points[i].m;
+	body.RecalculateBBox ();
+	body.CalculateEdges ();
+	CreateHandle (DynamicBodies.size () - 1);
+	return DynamicBodies.size () - 1;
+}
+
+size_t Physics::AddDynamicBody (const DynamicBody &body)
+{
+	AllocationPhase phase ("dynamic bodies");
+	DynamicBodies.push_back (DynamicBody (body.stiffness, &arena, body.topology));
+	DynamicBody &copy = DynamicBodies.back ();
+	copy.compliance = body.compliance;
+	copy.mass = body.mass;
+	copy.points.assign (body.points.begin (), body.points.end ());
+	copy.poles.assign (body.poles.begin (), body.poles.end ());
+	copy.edges.assign (body.edges.begin (), body.edges.end ());
+	copy.rest.assign (body.rest.begin (), body.rest.end ());
+	copy.level = body.level;
+	copy.last_timestep = body.last_timestep;
+	copy.filter = body.filter;
+	copy.RecalculateBBox ();
+	CreateHandle (DynamicBodies.size () - 1);
+	return DynamicBodies.size () - 1;
+}
+
+/// vertexes and axes of pair of narrow phase; narrow phase of chunks runs in several threads
+static thread_local SatKernel sat_kernel;
+
+bool Physics::isDynamicDynamic (size_t first, size_t second, CollisionInfo *info)
+{
+	//axes are normals of edges of the first body, then of the second one
+	DynamicBody *bodies[2] = {&DynamicBodies[first], &DynamicBodies[second]};
+	sat_kernel.Clear ();
+	for (int k = 0; k < 2; k++)
+	{
+		ArenaVector<Point> &points = bodies[k]->points;
+		for (size_t i = 0; i < points.size (); i++)
+			sat_kernel.AddVertex (k, points[i].cur_pos);
+		for (size_t i = 0; i < bodies[k]->edges.size (); i++)
+			sat_kernel.AddEdge (points[bodies[k]->edges[i].p1].cur_pos, points[bodies[k]->edges[i].p2].cur_pos);
+	}
+	size_t axis;
+	double first_max, second_max;
+	if (!sat_kernel.MinOverlap (&axis, &info->depth, &first_max, &second_max))
+		return false;
+	size_t edge_body = (axis < bodies[0]->edges.size ()) ? first : second;
+	Pole &edge = (edge_body == first) ? bodies[0]->edges[axis] : bodies[1]->edges[axis - bodies[0]->edges.size ()];
+	info->normal = sat_kernel.Axis (axis);
+	info->edge_p1 = edge.p1;
+	info->edge_p2 = edge.p2;
+	size_t vertex_body = (edge_body == first) ? second : first;
+
+	ArenaVector<Point> &points = DynamicBodies[vertex_body].points;
+	info->point = 0;
+	for (size_t i = 1; i < points.size (); i++)
+		if ((info->normal ^ points[i].cur_pos) < (info->normal ^ points[info->point].cur_pos))
+			info->point = i;
+	info->point_body = vertex_body;
+	info->edge_body = first + second - vertex_body;
+	info->is_point = false;
+	return true;
+}
+
+bool Physics::isDynamicStatic (size_t dynamic_body, size_t static_body, CollisionInfo *info)
+{
+	//axes are normals of edges of dynamic body, then of static one
+	DynamicBody &body = DynamicBodies[dynamic_body];
+	std::vector<vector2d> &static_points = StaticBodies[static_body].points;
+	sat_kernel.Clear ();
+	for (size_t i = 0; i < body.points.size (); i++)
+		sat_kernel.AddVertex (0, body.points[i].cur_pos);
+	for (size_t i = 0; i < static_points.size (); i++)
+		sat_kernel.AddVertex (1, static_points[i]);
+	for (size_t i = 0; i < body.edges.size (); i++)
+		sat_kernel.AddEdge (body.points[body.edges[i].p1].cur_pos, body.points[body.edges[i].p2].cur_pos);
+	for (size_t i = 0; i < static_points.size (); i++)
+		sat_kernel.AddEdge (static_points[i], static_points[(i + 1) % static_points.size ()]);
+	size_t axis;
+	double first_max, second_max;
+	if (!sat_kernel.MinOverlap (&axis, &info->depth, &first_max, &second_max))
+		return false;
+	vector2d normal = sat_kernel.Axis (axis);
+	info->is_point = axis >= body.edges.size ();
+	if (info->is_point)
+		info->normal = (first_max > second_max) ? normal : normal * (-1);
+	else
+	{
+		info->normal = (second_max > first_max) ? normal : normal * (-1);
+		info->edge_p1 = body.edges[axis].p1;
+		info->edge_p2 = body.edges[axis].p2;
+	}
+
+	info->edge_body = info->point_body = dynamic_body;
+	if (info->is_point)
+	{
+		ArenaVector<Point> &points = DynamicBodies[dynamic_body].points;
+		info->point = 0;
+		for (size_t i = 1; i < points.size (); i++)
+			if ((info->normal ^ points[i].cur_pos) < (info->normal ^ points[info->point].cur_pos))
+				info->point = i;
+	}
+	else
+	{
+		info->static_point = StaticBodies[static_body].points[0];
+		for (size_t i = 1; i < StaticBodies[static_body].points.size (); i++)
+			if ((info->normal ^ StaticBodies[static_body].points[i]) < (info->normal ^ info->static_point))
+				info->static_point = StaticBodies[static_body].points[i];
+	}
+	return true;
+}
+
+void Physics::ResolveDynamicDynamic (CollisionInfo *info, double depth)
+{
+	Point &point = DynamicBodies[info->point_body].points[info->point],
+		&edge_p1 = DynamicBodies[info->edge_body].points[info->edge_p1],
+		&edge_p2 = DynamicBodies[info->edge_body].points[info->edge_p2];
+	double sum_mass = DynamicBodies[info->edge_body].mass + DynamicBodies[info->point_body].mass;
+	point.cur_pos += info->normal * depth * (DynamicBodies[info->edge_body].mass / sum_mass);
+
+	double t = (point.cur_pos - edge_p1.cur_pos).len () * edge_p1.m /
+		((point.cur_pos - edge_p1.cur_pos).len () * edge_p1.m +
+		 (point.cur_pos - edge_p2.cur_pos).len () * edge_p2.m);
+	double lambda = 1.0 / (t * t + (1 - t) * (1 - t));
+	edge_p1.cur_pos -= info->normal * depth * (1 - t) * 0.5 * lambda;
+	edge_p2.cur_pos -= info->normal * depth * t * 0.5 * lambda;
+
+	//only moved points can grow boxes; box can stay bigger than body until next step
+	DynamicBodies[info->point_body].bbox.Expand (point.cur_pos);
+	DynamicBodies[info->edge_body].bbox.Expand (edge_p1.cur_pos);
+	DynamicBodies[info->edge_body].bbox.Expand (edge_p2.cur_pos);
+}
+
+void Physics::ResolveDynamicStatic (size_t dynamic_body, CollisionInfo *info, double depth)
+{
+	ArenaVector<Point> &points = DynamicBodies[dynamic_body].points;
+	BoundingBox &bbox = DynamicBodies[dynamic_body].bbox;
+	if (info->is_point)
+	{
+		points[info->point].cur_pos += info->normal * depth;
+		bbox.Expand (points[info->point].cur_pos);
+	}
+	else
+	{
+		Point &edge_p1 = points[info->edge_p1], &edge_p2 = points[info->edge_p2];
+		double t = (info->static_point - edge_p1.cur_pos).len () * edge_p1.m /
+			((edge_p1.cur_pos - info->static_point).len () * edge_p1.m +
+			 (edge_p2.cur_pos - info->static_point).len () * edge_p2.m);
+		double lambda = 1.0 / (t * t + (1 - t) * (1 - t));
+		edge_p1.cur_pos -= info->normal * depth * (1 - t) * lambda;
+		edge_p2.cur_pos -= info->normal * depth * t * lambda;
+		bbox.Expand (edge_p1.cur_pos);
+		bbox.Expand (edge_p2.cur_pos);
+	}
+}
+
+void Physics::WarmStartContact (Contact *contact)
+{
+	std::vector<Contact>::iterator cached = std::lower_bound (contact_cache.begin (), contact_cache.end (), *contact);
+	if (cached == contact_cache.end () || *contact < *cached || !contact->SameFeature (*cached))
+		return;
+	//contact that separates since previous step isn't pushed apart by its old correction
+	double warm = std::min (cached->accumulated * warm_start, contact->info.depth);
+	if (warm <= 0.0)
+		return;
+	CollisionInfo info = contact->info;
+	info.normal = cached->info.normal;
+	if (contact->is_static)
+		ResolveDynamicStatic (contact->first, &info, warm);
+	else
+		ResolveDynamicDynamic (&info, warm);
+	contact->info.depth -= warm * (info.normal ^ contact->info.normal);
+	contact->accumulated = warm;
+	contacts.push_back (*contact);
+}
+
+void Physics::ResolveContact (Contact contact)
+{
+	//correction is clamped to avoid explosions on fresh deep contacts; persistent contacts are warm-started
+	double depth = std::min (contact.info.depth, max_depth);
+	if (depth <= 0.0)
+		return;
+	if (contact.is_static)
+		ResolveDynamicStatic (contact.first, &contact.info, depth);
+	else
+		ResolveDynamicDynamic (&contact.info, depth);
+	contact.accumulated = depth;
+	contacts.push_back (contact);
+}
+
+void Physics::ContinuousCollision (size_t dynamic_body)
+{
+	ArenaVector<Point> &points = DynamicBodies[dynamic_body].points;
+	//swept bounding box
+	double max_displacement = 0.0;
+	BoundingBox swept = DynamicBodies[dynamic_body].bbox;
+	for (size_t i = 0; i < points.size (); i++)
+	{
+		double displacement = (points[i].cur_pos - points[i].old_pos).sqr_len ();
+		if (displacement > max_displacement)
+			max_displacement = displacement;
+		swept.lb.x = std::min (swept.lb.x, points[i].old_pos.x);
+		swept.lb.y = std::min (swept.lb.y, points[i].old_pos.y);
+		swept.rt.x = std::max (swept.rt.x, points[i].old_pos.x);
+		swept.rt.y = std::max (swept.rt.y, points[i].old_pos.y);
+	}
+	if (max_displacement < ccd_threshold * ccd_threshold)
+		return;
+
+	//conservative advancement: time of first impact of any vertex path
+	double toi = 1.0;
+	vector2d toi_normal;
+	static_tree.Query (swept, [&] (size_t j)
+	{
+		std::vector<vector2d> &static_points = StaticBodies[j].points;
+		for (size_t i = 0; i < points.size (); i++)
+		{
+			double enter;
+			vector2d normal;
+			if (SegmentConvex (points[i].old_pos, points[i].cur_pos, static_points.size (),
+							   [&static_points] (size_t k) { return static_points[k]; }, &enter, &normal) &&
+				enter < toi)
+			{
+				toi = enter;
+				toi_normal = normal;
+			}
+		}
+		return true;
+	});
+	if (toi < 1.0)
+	{
+		//body stops slightly before the contact and loses velocity towards static body
+		toi = std::max (0.0, toi - max_depth / sqrt (max_displacement));
+		for (size_t i = 0; i < points.size (); i++)
+		{
+			points[i].cur_pos = points[i].old_pos + (points[i].cur_pos - points[i].old_pos) * toi;
+			double speed = toi_normal ^ (points[i].cur_pos - points[i].old_pos);
+			if (speed < 0.0)
+				points[i].old_pos += toi_normal * speed;
+		}
+		DynamicBodies[dynamic_body].RecalculateBBox ();
+	}
+}
+
+/**
+@brief pushes circle out of ground of terrain
+@param center pointer to center of circle
+@param r radius of circle
+*/
+static void push_out_of_terrain (const Terrain &terrain, vector2d *center, double r)
+{
+	size_t first, last;
+	if (center->y - r > terrain.bbox.rt.y || !terrain.Segments (center->x - r, center->x + r, &first, &last))
+		return;
+	for (size_t k = first; k <= last; k++)
+	{
+		vector2d p1 = terrain.points[k], p2 = terrain.points[k + 1];
+		vector2d normal = vector2d (p1.y - p2.y, p2.x - p1.x).norm ();
+		double distance = normal ^ (*center - p1);
+		if (distance >= r)
+			continue;
+		vector2d d = p2 - p1;
+		double s = ((*center - p1) ^ d) / d.sqr_len ();
+		if (s >= 0.0 && s <= 1.0)
+		{
+			*center += normal * std::min (r - distance, max_depth);
+			continue;
+		}
+		//center is beyond segment; circle above the line can touch its end
+		vector2d v = *center - (s < 0.0 ? p1 : p2);
+		double length = v.len ();
+		if (distance > 0.0 && length < r && length > DBL_EPSILON)
+			*center += v * (std::min (r - length, max_depth) / length);
+	}
+}
+
+void Physics::CollideParticles ()
+{
+	if (Particles.empty ())
+		return;
+	//particle - particle
+	const std::vector<size_t> &order = particle_grid.Order ();
+	BoundingBox extent;
+	for (size_t k = 0; k < order.size (); k++)
+	{
+		size_t i = order[k];
+		extent.Expand (Particles[i].cur_pos);
+		int x, y;
+		particle_grid.Cell (Particles[i].cur_pos, &x, &y);
+		//neighbour cells can share bucket; every bucket is checked once
+		size_t buckets[9], buckets_num = 0;
+		for (int dx = -1; dx <= 1; dx++)
+			for (int dy = -1; dy <= 1; dy++)
+			{
+				size_t bucket = particle_grid.Bucket (x + dx, y + dy);
+				bool unique = true;
+				for (size_t b = 0; b < buckets_num; b++)
+					if (buckets[b] == bucket)
+						unique = false;
+				if (unique)
+					buckets[buckets_num++] = bucket;
+			}
+		for (size_t b = 0; b < buckets_num; b++)
+		{
+			const size_t *begin, *end;
+			particle_grid.Items (buckets[b], &begin, &end);
+			for (const size_t *j = begin; j != end; j++)
+			{
+				if (*j <= i)
+					continue;
+				Particle &p1 = Particles[i], &p2 = Particles[*j];
+				vector2d d = p2.cur_pos - p1.cur_pos;
+				double min_distance = p1.r + p2.r;
+				double sqr_distance = d.sqr_len ();
+				if (sqr_distance >= min_distance * min_distance || sqr_distance < DBL_EPSILON)
+					continue;
+				double distance = sqrt (sqr_distance);
+				vector2d correction = d * (std::min (min_distance - distance, max_depth) / (distance * (p1.m + p2.m)));
+				p1.cur_pos -= correction * p2.m;
+				p2.cur_pos += correction * p1.m;
+			}
+		}
+	}
+
+	//particle - body; only bodies near particles are checked
+	extent.lb -= vector2d (max_radius + max_depth, max_radius + max_depth);
+	extent.rt += vector2d (max_radius + max_depth, max_radius + max_depth);
+	particle_statics.clear ();
+	particle_dynamics.clear ();
+	static_tree.Query (extent, [this, extent] (size_t j)
+	{
+		if (StaticBodies[j].bbox * extent)
+			particle_statics.push_back (j);
+		return true;
+	});
+	dynamic_tree.Query (extent, [this, extent] (size_t j)
+	{
+		if (DynamicBodies[j].bbox * extent)
+			particle_dynamics.push_back (j);
+		return true;
+	});
+	//order of tree leaves depends on history of tree
+	std::sort (particle_statics.begin (), particle_statics.end ());
+	std::sort (particle_dynamics.begin (), particle_dynamics.end ());
+	//cells of bounding box of body are visited, unless there are more cells than particles
+	for (size_t i = 0; i < particle_statics.size () + particle_dynamics.size (); i++)
+	{
+		bool is_static = i < particle_statics.size ();
+		size_t body = is_static ? particle_statics[i] : particle_dynamics[i - particle_statics.size ()];
+		BoundingBox bbox = is_static ? StaticBodies[body].bbox : DynamicBodies[body].bbox;
+		bbox.lb -= vector2d (max_radius, max_radius);
+		bbox.rt += vector2d (max_radius, max_radius);
+
+		int x1, y1, x2, y2;
+		particle_grid.Cell (bbox.lb, &x1, &y1);
+		particle_grid.Cell (bbox.rt, &x2, &y2);
+		size_t width = x2 - x1 + 1;
+		bool by_cells = (double)width * (y2 - y1 + 1) < Particles.size ();
+		size_t cells = by_cells ? width * (y2 - y1 + 1) : 1;
+		for (size_t c = 0; c < cells; c++)
+		{
+			const size_t *begin = order.data (), *end = order.data () + order.size ();
+			if (by_cells)
+				particle_grid.Items (particle_grid.Bucket (x1 + (int)(c % width), y1 + (int)(c / width)), &begin, &end);
+			for (const size_t *j = begin; j != end; j++)
+			{
+				Particle &particle = Particles[*j];
+				if (!(BoundingBox (particle.cur_pos - vector2d (particle.r, particle.r),
+								   particle.cur_pos + vector2d (particle.r, particle.r)) * bbox))
+					continue;
+				vector2d normal;
+				double depth;
+				size_t edge;
+				if (is_static)
+				{
+					std::vector<vector2d> &points = StaticBodies[body].points;
+					if (CircleConvex (particle.cur_pos, particle.r, points.size (),
+									  [&points] (size_t k) { return points[k]; }, &normal, &depth, &edge))
+						particle.cur_pos += normal * std::min (depth, max_depth);
+				}
+				else
+				{
+					DynamicBody &dynamic = DynamicBodies[body];
+					ArenaVector<Point> &points = dynamic.points;
+					if (CircleConvex (particle.cur_pos, particle.r, points.size (),
+									  [&points] (size_t k) { return points[k].cur_pos; }, &normal, &depth, &edge))
 					{
-						// collision responce
-						if (info.depth > max_depth)
-							info.depth = max_depth;
-						if (info.is_point)
-							info.point->cur_pos += info.normal * info.depth;
-						else
-						{
-							double t = (info.static_point - info.edge.p1->cur_pos).len() * info.edge.p1->m /
-								((info.edge.p1->cur_pos - info.static_point).len () * info.edge.p1->m +
-								 (info.edge.p2->cur_pos - info.static_point).len () * info.edge.p2->m);
-							double lambda = 1.0 / (t * t + (1 - t) * (1 - t));
-							info.edge.p1->cur_pos -= info.normal * info.depth * (1-t) * lambda;
-							info.edge.p2->cur_pos -= info.normal * info.depth * t * lambda;
-						}
-						DynamicBodies[i].RecalculateBBox ();
+						//particle is pushed like vertex of body, body is pushed by its edge
+						depth = std::min (depth, max_depth);
+						double sum_mass = dynamic.mass + particle.m;
+						particle.cur_pos += normal * depth * (dynamic.mass / sum_mass);
+						Point &p1 = points[edge], &p2 = points[(edge + 1) % points.size ()];
+						double t = (particle.cur_pos - p1.cur_pos).len () * p1.m /
+							((particle.cur_pos - p1.cur_pos).len () * p1.m +
+							 (particle.cur_pos - p2.cur_pos).len () * p2.m);
+						double lambda = 1.0 / (t * t + (1 - t) * (1 - t));
+						double edge_depth = depth * (particle.m / sum_mass);
+						p1.cur_pos -= normal * edge_depth * (1 - t) * lambda;
+						p2.cur_pos -= normal * edge_depth * t * lambda;
+						dynamic.bbox.Expand (p1.cur_pos);
+						dynamic.bbox.Expand (p2.cur_pos);
 					}
+				}
+			}
+		}
+	}
+
+	//particle - terrain; ground is below terrain, so only particles above it are skipped
+	for (size_t index = 0; index < Terrains.size (); index++)
+		if (extent.lb.y <= Terrains[index].bbox.rt.y && extent.lb.x <= Terrains[index].bbox.rt.x &&
+			extent.rt.x >= Terrains[index].bbox.lb.x)
+			for (size_t i = 0; i < Particles.size (); i++)
+				push_out_of_terrain (Terrains[index], &Particles[i].cur_pos, Particles[i].r);
+}
+
+/**
+@return inverse mass of edge in its point with parameter s, when ends of edge are moved by their inverse masses
+@param w1, w2 inverse masses of ends
+*/
+static double edge_inv_mass (double w1, double w2, double s)
+{
+	return w1 * (1 - s) * (1 - s) + w2 * s * s;
+}
+
+/**
+@brief moves ends of edge by their inverse masses, so that point of edge with parameter s is moved by correction
+@param p1, p2 pointers to ends of edge
+@param w1, w2 inverse masses of ends
+*/
+static void move_edge (vector2d *p1, vector2d *p2, double w1, double w2, double s, vector2d correction)
+{
+	double w = edge_inv_mass (w1, w2, s);
+	if (w <= 0.0)
+		return;
+	*p1 += correction * (w1 * (1 - s) / w);
+	*p2 += correction * (w2 * s / w);
+}
+
+void Physics::CollideLattice (size_t lattice, size_t body, bool is_static)
+{
+	LatticeBody &outline = LatticeBodies[lattice];
+	std::vector<Point> &points = outline.points;
+	std::vector<size_t> &boundary = outline.boundary;
+	double r = outline.radius;
+	StaticBody *static_body = is_static ? &StaticBodies[body] : NULL;
+	DynamicBody *dynamic_body = is_static ? NULL : &DynamicBodies[body];
+	size_t n = is_static ? static_body->points.size () : dynamic_body->points.size ();
+	auto vertex = [static_body, dynamic_body] (size_t k)
+	{
+		return static_body ? static_body->points[k] : dynamic_body->points[k].cur_pos;
+	};
+	//static body doesn't move
+	auto vertex_inv_mass = [dynamic_body] (size_t k)
+	{
+		return dynamic_body ? 1 / dynamic_body->points[k].m : 0.0;
+	};
+
+	//points of outline in body; body is pushed by its edge
+	for (size_t b = 0; b < boundary.size (); b++)
+	{
+		size_t p = boundary[b];
+		BoundingBox body_box = is_static ? static_body->bbox : dynamic_body->bbox;
+		vector2d normal;
+		double depth;
+		size_t edge;
+		if (!(BoundingBox (points[p].cur_pos - vector2d (r, r), points[p].cur_pos + vector2d (r, r)) * body_box) ||
+			!CircleConvex (points[p].cur_pos, r, n, vertex, &normal, &depth, &edge))
+			continue;
+		depth = std::min (depth, max_depth);
+		size_t next = (edge + 1) % n;
+		vector2d v1 = vertex (edge), d = vertex (next) - v1;
+		double s = std::max (0.0, std::min (1.0, ((points[p].cur_pos - v1) ^ d) / d.sqr_len ()));
+		double w_point = outline.inv_mass[p], w_edge = edge_inv_mass (vertex_inv_mass (edge), vertex_inv_mass (next), s);
+		if (w_point + w_edge <= 0.0)
+			continue;
+		points[p].cur_pos += normal * (depth * w_point / (w_point + w_edge));
+		if (dynamic_body)
+		{
+			Point &p1 = dynamic_body->points[edge], &p2 = dynamic_body->points[next];
+			move_edge (&p1.cur_pos, &p2.cur_pos, 1 / p1.m, 1 / p2.m, s, normal * (-depth * w_edge / (w_point + w_edge)));
+			dynamic_body->bbox.Expand (p1.cur_pos);
+			dynamic_body->bbox.Expand (p2.cur_pos);
+		}
+	}
+
+	//vertexes of body in capsules of edges of outline
+	for (size_t k = 0; k < n; k++)
+	{
+		vector2d v = vertex (k);
+		if (!outline.bbox.Contains (v))
+			continue;
+		double w_vertex = vertex_inv_mass (k);
+		for (size_t b = 0; b < boundary.size (); b++)
+		{
+			size_t p1 = boundary[b], p2 = boundary[(b + 1) % boundary.size ()];
+			vector2d start = points[p1].cur_pos, d = points[p2].cur_pos - start;
+			if (d.sqr_len () < DBL_EPSILON)
+				continue;
+			double s = std::max (0.0, std::min (1.0, ((v - start) ^ d) / d.sqr_len ()));
+			vector2d offset = v - (start + d * s);
+			double distance = offset.len ();
+			if (distance >= r)
+				continue;
+			//outline is counter-clockwise, so its outer normal is on the right side of edge
+			vector2d normal = distance > DBL_EPSILON ? offset / distance : vector2d (d.y, -d.x).norm ();
+			double depth = std::min (r - distance, max_depth);
+			double w_edge = edge_inv_mass (outline.inv_mass[p1], outline.inv_mass[p2], s);
+			if (w_vertex + w_edge <= 0.0)
+				continue;
+			move_edge (&points[p1].cur_pos, &points[p2].cur_pos, outline.inv_mass[p1], outline.inv_mass[p2], s,
+					   normal * (-depth * w_edge / (w_vertex + w_edge)));
+			if (dynamic_body)
+			{
+				dynamic_body->points[k].cur_pos += normal * (depth * w_vertex / (w_vertex + w_edge));
+				v = dynamic_body->points[k].cur_pos;
+				dynamic_body->bbox.Expand (v);
+			}
+		}
+	}
+}
+
+void Physics::CollideLattices ()
+{
+	for (size_t i = 0; i < LatticeBodies.size (); i++)
+	{
+		LatticeBody &lattice = LatticeBodies[i];
+		BoundingBox bbox = lattice.bbox;
+		lattice_statics.clear ();
+		lattice_dynamics.clear ();
+		static_tree.Query (bbox, [this, bbox] (size_t j)
+		{
+			if (StaticBodies[j].bbox * bbox)
+				lattice_statics.push_back (j);
+			return true;
+		});
+		dynamic_tree.Query (bbox, [this, bbox] (size_t j)
+		{
+			if (DynamicBodies[j].bbox * bbox)
+				lattice_dynamics.push_back (j);
+			return true;
+		});
+		//order of tree leaves depends on history of tree
+		std::sort (lattice_statics.begin (), lattice_statics.end ());
+		std::sort (lattice_dynamics.begin (), lattice_dynamics.end ());
+		for (size_t j = 0; j < lattice_statics.size (); j++)
+			CollideLattice (i, lattice_statics[j], true);
+		for (size_t j = 0; j < lattice_dynamics.size (); j++)
+			CollideLattice (i, lattice_dynamics[j], false);
+		for (size_t index = 0; index < Terrains.size (); index++)
+			for (size_t b = 0; b < lattice.boundary.size (); b++)
+				if (lattice.inv_mass[lattice.boundary[b]] > 0.0)
+					push_out_of_terrain (Terrains[index], &lattice.points[lattice.boundary[b]].cur_pos, lattice.radius);
+		lattice.RecalculateBBox ();
+	}
+}
+
+void Physics::CollideRopes ()
+{
+	for (size_t i = 0; i < Ropes.size (); i++)
+	{
+		Rope &rope = Ropes[i];
+		std::vector<Point> &points = rope.points;
+		double r = rope.radius;
+		BoundingBox bbox = rope.bbox;
+		rope_statics.clear ();
+		static_tree.Query (bbox, [this, bbox] (size_t j)
+		{
+			if (StaticBodies[j].bbox * bbox)
+				rope_statics.push_back (j);
+			return true;
+		});
+		//order of tree leaves depends on history of tree
+		std::sort (rope_statics.begin (), rope_statics.end ());
+		for (size_t j = 0; j < rope_statics.size (); j++)
+		{
+			StaticBody &body = StaticBodies[rope_statics[j]];
+			std::vector<vector2d> &vertexes = body.points;
+			//points in body
+			for (size_t k = 0; k < points.size (); k++)
+			{
+				vector2d normal;
+				double depth;
+				size_t edge;
+				if (rope.inv_mass[k] > 0.0 &&
+					(BoundingBox (points[k].cur_pos - vector2d (r, r), points[k].cur_pos + vector2d (r, r)) * body.bbox) &&
+					CircleConvex (points[k].cur_pos, r, vertexes.size (), [&vertexes] (size_t n) { return vertexes[n]; },
+								  &normal, &depth, &edge))
+					points[k].cur_pos += normal * std::min (depth, max_depth);
+			}
+			//vertexes of body in links; link is bent around vertex
+			for (size_t n = 0; n < vertexes.size (); n++)
+			{
+				vector2d v = vertexes[n];
+				if (!bbox.Contains (v))
+					continue;
+				for (size_t k = 0; k + 1 < points.size (); k++)
+				{
+					vector2d start = points[k].cur_pos, d = points[k + 1].cur_pos - start;
+					if (d.sqr_len () < DBL_EPSILON)
+						continue;
+					double s = std::max (0.0, std::min (1.0, ((v - start) ^ d) / d.sqr_len ()));
+					vector2d offset = start + d * s - v;
+					double distance = offset.len ();
+					if (distance >= r || distance < DBL_EPSILON)
+						continue;
+					move_edge (&points[k].cur_pos, &points[k + 1].cur_pos, rope.inv_mass[k], rope.inv_mass[k + 1], s,
+							   offset * (std::min (r - distance, max_depth) / distance));
+				}
+			}
+		}
+		for (size_t index = 0; index < Terrains.size (); index++)
+			for (size_t k = 0; k < points.size (); k++)
+				if (rope.inv_mass[k] > 0.0)
+					push_out_of_terrain (Terrains[index], &points[k].cur_pos, r);
+		rope.RecalculateBBox ();
+	}
+}
+
+unsigned int Physics::Tier (size_t dynamic_body)
+{
+	BoundingBox &bbox = DynamicBodies[dynamic_body].bbox;
+	double distance = std::max (std::max (region.lb.x - bbox.rt.x, bbox.lb.x - region.rt.x),
+								std::max (region.lb.y - bbox.rt.y, bbox.lb.y - region.rt.y));
+	if (distance <= 0.0)
+		return 0;
+	return (unsigned int)std::min ((double)tiers, floor (distance / tier_distance));
+}
+
+void Physics::IntegrateBodies (size_t chunk)
+{
+	size_t last = std::min ((chunk + 1) * chunk_bodies, DynamicBodies.size ());
+	for (size_t i = chunk * chunk_bodies; i < last; i++)
+	{
+		DynamicBody &body = DynamicBodies[i];
+		//body of tier k covers 2^k steps; it can go to slower tier only at step that starts its period
+		body.active = (step_index & ((1 << body.level) - 1)) == 0;
+		if (!body.active)
+			continue;
+		ArenaVector<Point> &points = body.points;
+		unsigned int tier = 0;
+		if (tiers)
+		{
+			//body moves to slower tier only if it would move less than max depth per step there;
+			//tier is coarsened by one level at once, so jitter of contacts isn't amplified by big ratio of timesteps
+			double displacement = 0.0;
+			for (size_t j = 0; j < points.size (); j++)
+				displacement = std::max (displacement, (points[j].cur_pos - points[j].old_pos).sqr_len ());
+			//displacement of the first step is taken as displacement per step of world
+			displacement = sqrt (displacement);
+			if (body.last_timestep > 0.0)
+				displacement *= t / body.last_timestep;
+			tier = Tier (i);
+			while (tier > 0 && displacement * (1 << tier) > max_depth * 0.25)
+				tier--;
+			if (tier > body.level)
+				tier = (step_index & ((2 << body.level) - 1)) ? body.level : body.level + 1;
+		}
+		body.level = tier;
+		double timestep = t * (1 << body.level);
+		double previous_timestep = body.last_timestep > 0.0 ? body.last_timestep : timestep;
+		body.last_timestep = timestep;
+
+		//body with compliance is integrated and solved in substeps; other bodies keep relaxation of one pass
+		unsigned int body_substeps = body.compliance < 0.0 ? 1 : substeps;
+		double substep = timestep / body_substeps;
+		for (unsigned int k = 0; k < body_substeps; k++)
+		{
+			for (size_t j = 0; j < points.size (); j++)
+			{
+				vector2d gravity = a;
+				if (mutual_gravity)
+					gravity += gravity_tree.Field (points[j].cur_pos, gravity_theta, gravity_softening) * gravity_constant;
+				if (k || substep == previous_timestep)
+					points[j].Update (substep, gravity);
+				else
+					points[j].Update (substep, previous_timestep, gravity);
+			}
+			if (body.compliance < 0.0)
+				body.UpdatePoles ();
+			else
+				body.SolvePoles (substep, constraint_iterations);
+		}
+		//old position keeps displacement of whole step, so collision response isn't scaled by number of substeps
+		if (body_substeps > 1)
+			for (size_t j = 0; j < points.size (); j++)
+				points[j].old_pos = points[j].cur_pos - (points[j].cur_pos - points[j].old_pos) * body_substeps;
+
+		body.RecalculateBBox ();
+		if (ccd)
+			ContinuousCollision (i);
+	}
+}
+
+void Physics::IntegrateParticles ()
+{
+	for (size_t i = 0; i < Particles.size (); i++)
+	{
+		Particles[i].Update (t, mutual_gravity ? a + particle_gravity[i] * gravity_constant : a);
+		//particles are not ordered, so the last one takes place of destroyed
+		if (!world_box.Contains (Particles[i].cur_pos))
+		{
+			Particles[i] = Particles.back ();
+			Particles.pop_back ();
+			if (mutual_gravity)
+			{
+				particle_gravity[i] = particle_gravity.back ();
+				particle_gravity.pop_back ();
+			}
+			i--;
+		}
+	}
+}
+
+/**
+@brief integrates unpinned points of lattice body or rope in substeps and solves its constraints after every substep
+@param timestep timestep of world
+*/
+template <class Body>
+static void integrate_substeps (Body &body, double timestep, unsigned int substeps, unsigned int iterations, vector2d gravity)
+{
+	std::vector<Point> &points = body.points;
+	double substep = timestep / substeps;
+	for (unsigned int k = 0; k < substeps; k++)
+	{
+		//old position keeps displacement of whole previous step
+		for (size_t j = 0; j < points.size (); j++)
+			if (body.inv_mass[j] > 0.0)
+			{
+				if (k || substeps == 1)
+					points[j].Update (substep, gravity);
+				else
+					points[j].Update (substep, timestep, gravity);
+			}
+		body.Solve (substep, iterations);
+	}
+	if (substeps > 1)
+		for (size_t j = 0; j < points.size (); j++)
+			points[j].old_pos = points[j].cur_pos - (points[j].cur_pos - points[j].old_pos) * substeps;
+	body.RecalculateBBox ();
+}
+
+void Physics::IntegrateLattice (size_t lattice)
+{
+	integrate_substeps (LatticeBodies[lattice], t, substeps, constraint_iterations, a);
+}
+
+void Physics::IntegrateRope (size_t rope)
+{
+	integrate_substeps (Ropes[rope], t, substeps, constraint_iterations, a);
+}
+
+void Physics::BuildGravityTree ()
+{
+	gravity_tree.Clear ();
+	for (size_t i = 0; i < DynamicBodies.size (); i++)
+		for (size_t j = 0; j < DynamicBodies[i].points.size (); j++)
+			gravity_tree.AddMass (DynamicBodies[i].points[j].cur_pos, DynamicBodies[i].points[j].m);
+	for (size_t i = 0; i < Particles.size (); i++)
+		gravity_tree.AddMass (Particles[i].cur_pos, Particles[i].m);
+	gravity_tree.Build ();
+	particle_gravity.resize (Particles.size ());
+}
+
+void Physics::ParticleGravity (size_t chunk)
+{
+	size_t last = std::min ((chunk + 1) * chunk_particles, Particles.size ());
+	for (size_t i = chunk * chunk_particles; i < last; i++)
+		particle_gravity[i] = gravity_tree.Field (Particles[i].cur_pos, gravity_theta, gravity_softening);
+}
+
+void Physics::SetConstraintSolver (unsigned int substeps_num, unsigned int iterations)
+{
+	substeps = std::max (substeps_num, 1u);
+	constraint_iterations = std::max (iterations, 1u);
+}
+
+void Physics::SetRegionOfInterest (BoundingBox box, double distance, unsigned int tiers_num)
+{
+	region = box;
+	tier_distance = distance;
+	tiers = tiers_num;
+}
+
+void Physics::SetMutualGravity (bool enabled, double constant, double theta, double softening)
+{
+	mutual_gravity = enabled;
+	gravity_constant = constant;
+	gravity_theta = theta;
+	gravity_softening = softening;
+}
+
+void Physics::UpdateBroadPhase ()
+{
+	for (size_t i = 0; i < DynamicBodies.size (); i++)
+	{
+		if (!(DynamicBodies[i].bbox * world_box))
+		{
+			DestroyDynamicBody (i--);
+			continue;
+		}
+		RefitProxy (i);
+	}
+	if (!Particles.empty ())
+		particle_grid.Build (Particles, 2.0 * max_radius);
+	for (size_t i = 0; i < LatticeBodies.size (); i++)
+		if (!(LatticeBodies[i].bbox * world_box))
+		{
+			LatticeBodies.erase (LatticeBodies.begin () + i--);
+			log (LOG_INFO, "lattice body destroyed");
+		}
+	for (size_t i = 0; i < Ropes.size (); i++)
+		if (!(Ropes[i].bbox * world_box))
+		{
+			Ropes.erase (Ropes.begin () + i--);
+			log (LOG_INFO, "rope destroyed");
 		}
+}
+
+void Physics::FindPairs (size_t chunk, bool is_static)
+{
+	std::vector<Contact> &pairs = is_static ? static_pairs[chunk] : dynamic_pairs[chunk];
+	pairs.clear ();
+	size_t last = std::min ((chunk + 1) * chunk_bodies, DynamicBodies.size ());
+	for (size_t i = chunk * chunk_bodies; i < last; i++)
+	{
+		size_t first_pair = pairs.size ();
+		BoundingBox bbox = DynamicBodies[i].bbox;
+		//pairs of inactive body with active ones are found from side of active body
+		if (!DynamicBodies[i].active)
+			continue;
+		//filtered pairs are dropped before narrow phase
+		CollisionFilter filter = DynamicBodies[i].filter;
+		if (is_static)
+			static_tree.Query (bbox, [this, i, bbox, filter, &pairs] (size_t j)
+			{
+				if (filter.Collides (StaticBodies[j].filter) && StaticBodies[j].bbox * bbox)
+					pairs.push_back (Contact (i, j, true));
+				return true;
+			});
+		else
+			dynamic_tree.Query (bbox, [this, i, bbox, filter, &pairs] (size_t j)
+			{
+				if ((j > i || (j < i && !DynamicBodies[j].active)) && filter.Collides (DynamicBodies[j].filter) &&
+					DynamicBodies[j].bbox * bbox)
+					pairs.push_back (Contact (std::min (i, j), std::max (i, j), false));
+				return true;
+			});
+		//order of tree leaves depends on history of tree
+		std::sort (pairs.begin () + first_pair, pairs.end ());
 	}
 }
+
+void Physics::CollidePairs (size_t chunk, bool is_static)
+{
+	std::vector<Contact> &pairs = is_static ? static_pairs[chunk] : dynamic_pairs[chunk];
+	size_t collided = 0;
+	for (size_t k = 0; k < pairs.size (); k++)
+	{
+		Contact &pair = pairs[k];
+		bool collision = is_static ? isDynamicStatic (pair.first, pair.second, &pair.info) :
+			isDynamicDynamic (pair.first, pair.second, &pair.info);
+		if (collision)
+			pairs[collided++] = pair;
+	}
+	pairs.resize (collided, Contact (0, 0, false));
+}
+
+void Physics::ResolvePairs (bool first_iteration)
+{
+	//all persistent contacts get their previous corrections before any contact is resolved
+	if (first_iteration && warm_start > 0.0)
+		for (size_t chunk = 0; chunk < dynamic_pairs.size (); chunk++)
+		{
+			for (size_t k = 0; k < dynamic_pairs[chunk].size (); k++)
+				WarmStartContact (&dynamic_pairs[chunk][k]);
+			for (size_t k = 0; k < static_pairs[chunk].size (); k++)
+				WarmStartContact (&static_pairs[chunk][k]);
+		}
+	for (size_t chunk = 0; chunk < dynamic_pairs.size (); chunk++)
+	{
+		for (size_t k = 0; k < dynamic_pairs[chunk].size (); k++)
+			ResolveContact (dynamic_pairs[chunk][k]);
+		for (size_t k = 0; k < static_pairs[chunk].size (); k++)
+			ResolveContact (static_pairs[chunk][k]);
+		CollideTerrains (chunk);
+	}
+	CollideParticles ();
+	CollideLattices ();
+	CollideRopes ();
+
+	//bodies moved by collision response are refit, so pairs of the next iteration and queries between steps
+	//see actual boxes; response can move body farther than margin of its leaf
+	for (size_t i = 0; i < DynamicBodies.size (); i++)
+		RefitProxy (i);
+}
+
+void Physics::FinishStep ()
+{
+	//contacts are sorted once per step; order of resolving keeps feature of the last iteration of pair
+	contact_order.resize (contacts.size ());
+	for (size_t i = 0; i < contacts.size (); i++)
+		contact_order[i] = i;
+	std::sort (contact_order.begin (), contact_order.end (), [this] (size_t a, size_t b)
+	{
+		return contacts[a] < contacts[b] || (!(contacts[b] < contacts[a]) && a < b);
+	});
+	contact_cache.clear ();
+	for (size_t k = 0; k < contact_order.size (); k++)
+	{
+		const Contact &contact = contacts[contact_order[k]];
+		if (contact_cache.empty () || contact_cache.back () < contact)
+			contact_cache.push_back (contact);
+		else
+		{
+			double accumulated = contact_cache.back ().accumulated + contact.accumulated;
+			contact_cache.back () = contact;
+			contact_cache.back ().accumulated = accumulated;
+		}
+	}
+}
+
+void Physics::SetThreads (unsigned int threads)
+{
+	if (threads == 1)
+		pool.reset ();
+	else
+		pool.reset (new ThreadPool (threads));
+}
+
+void Physics::SetTaskTimer (TaskGraph::Timer timer)
+{
+	task_timer = timer;
+}
+
+/**
+@return bytes of memory of array
+*/
+template <class T>
+static size_t capacity_bytes (const std::vector<T> &array)
+{
+	return array.capacity () * sizeof (T);
+}
+
+void Physics::GetMemoryStats (MemoryStats *stats)
+{
+	//points, poles and edges of bodies are blocks of arena
+	stats->dynamic_bodies = capacity_bytes (DynamicBodies) + arena.Used ();
+	stats->static_bodies = capacity_bytes (StaticBodies) + static_tree.Memory ();
+	for (size_t i = 0; i < StaticBodies.size (); i++)
+		stats->static_bodies += capacity_bytes (StaticBodies[i].points);
+	stats->terrains = capacity_bytes (Terrains);
+	for (size_t i = 0; i < Terrains.size (); i++)
+		stats->terrains += Terrains[i].Memory ();
+	stats->particles = capacity_bytes (Particles) + capacity_bytes (particle_buffer) + capacity_bytes (particle_statics) +
+		capacity_bytes (particle_dynamics) + capacity_bytes (particle_gravity) +
+		particle_grid.Memory ();
+	stats->lattice_bodies = capacity_bytes (LatticeBodies) + capacity_bytes (lattice_statics) +
+		capacity_bytes (lattice_dynamics);
+	for (size_t i = 0; i < LatticeBodies.size (); i++)
+		stats->lattice_bodies += LatticeBodies[i].Memory ();
+	stats->ropes = capacity_bytes (Ropes) + capacity_bytes (rope_statics);
+	for (size_t i = 0; i < Ropes.size (); i++)
+		stats->ropes += Ropes[i].Memory ();
+	stats->contacts = capacity_bytes (contacts) + capacity_bytes (contact_cache) + capacity_bytes (contact_order) + capacity_bytes (dynamic_pairs) +
+		capacity_bytes (static_pairs);
+	for (size_t chunk = 0; chunk < dynamic_pairs.size (); chunk++)
+		stats->contacts += capacity_bytes (dynamic_pairs[chunk]) + capacity_bytes (static_pairs[chunk]);
+	stats->other = dynamic_tree.Memory () + gravity_tree.Memory () + capacity_bytes (handle_index) +
+		capacity_bytes (handle_generation) + capacity_bytes (free_handles) + capacity_bytes (reorder_keys) +
+		capacity_bytes (new_index) + capacity_bytes (reorder_buffer);
+	stats->arena_free = arena.Reserved () - arena.Used ();
+	stats->total = stats->dynamic_bodies + stats->static_bodies + stats->terrains + stats->particles +
+		stats->lattice_bodies + stats->ropes + stats->contacts + stats->other + stats->arena_free;
+}
+
+void Physics::SetAllocationCheck (bool enabled)
+{
+	allocation_check = enabled;
+	if (enabled)
+	{
+		//without replacement of operator new the check would always pass
+		if (!AllocationTracker::Installed ())
+			log (LOG_FAIL, "allocation check needs program linked with allocation_hooks");
+		AllocationTracker::Enable (true);
+		//counters are collected inside of checked update, so their arrays must not grow there
+		allocations_before.reserve (AllocationTracker::max_phases);
+		allocations_after.reserve (AllocationTracker::max_phases);
+	}
+}
+
+void Physics::CheckAllocations ()
+{
+	AllocationTracker::Collect (&allocations_after);
+	bool allocated = false;
+	for (size_t i = 0; i < allocations_after.size (); i++)
+	{
+		size_t allocations = allocations_after[i].allocations, bytes = allocations_after[i].bytes;
+		for (size_t k = 0; k < allocations_before.size (); k++)
+			if (!strcmp (allocations_before[k].phase, allocations_after[i].phase))
+			{
+				allocations -= allocations_before[k].allocations;
+				bytes -= allocations_before[k].bytes;
+			}
+		if (allocations)
+		{
+			log (LOG_INFO, "step %u: %u allocations of %u bytes in phase \"%s\"", (unsigned int)step_index,
+				 (unsigned int)allocations, (unsigned int)bytes, allocations_after[i].phase);
+			allocated = true;
+		}
+	}
+	if (allocated)
+		log (LOG_FAIL, "update allocated heap memory in steady state");
+}
+
+void Physics::CollideTerrains (size_t chunk)
+{
+	size_t last_body = std::min ((chunk + 1) * chunk_bodies, DynamicBodies.size ());
+	for (size_t index = 0; index < Terrains.size (); index++)
+	{
+		const Terrain &terrain = Terrains[index];
+		for (size_t i = chunk * chunk_bodies; i < last_body; i++)
+		{
+			DynamicBody &body = DynamicBodies[i];
+			size_t first, last;
+			if (!body.active || !body.filter.Collides (terrain.filter) || body.bbox.lb.y > terrain.bbox.rt.y ||
+				!terrain.Segments (body.bbox.lb.x, body.bbox.rt.x, &first, &last))
+				continue;
+			ArenaVector<Point> &points = body.points;
+			CollisionInfo info;
+			//points under the line
+			info.is_point = true;
+			for (size_t j = 0; j < points.size (); j++)
+			{
+				size_t segment, unused;
+				if (!terrain.Segments (points[j].cur_pos.x, points[j].cur_pos.x, &segment, &unused))
+					continue;
+				vector2d p1 = terrain.points[segment], p2 = terrain.points[segment + 1];
+				info.normal = vector2d (p1.y - p2.y, p2.x - p1.x).norm ();
+				double depth = info.normal ^ (p1 - points[j].cur_pos);
+				if (depth > 0.0)
+				{
+					info.point = j;
+					ResolveDynamicStatic (i, &info, std::min (depth, max_depth));
+				}
+			}
+			//peaks of the line inside of body
+			info.is_point = false;
+			for (size_t k = first; k <= last + 1; k++)
+			{
+				vector2d v = terrain.points[k];
+				if (k > 0 && k + 1 < terrain.points.size ())
+				{
+					vector2d previous = terrain.points[k - 1], next = terrain.points[k + 1];
+					if (((v - previous) * (next - v)) >= 0.0)
+						continue;
+				}
+				double depth;
+				size_t edge;
+				if (!body.bbox.Contains (v) ||
+					!CircleConvex (v, 0.0, points.size (), [&points] (size_t n) { return points[n].cur_pos; },
+								   &info.normal, &depth, &edge))
+					continue;
+				info.edge_p1 = edge;
+				info.edge_p2 = (edge + 1) % points.size ();
+				info.static_point = v;
+				ResolveDynamicStatic (i, &info, std::min (depth, max_depth));
+			}
+		}
+	}
+}
+
+void Physics::Update (unsigned int iterations)
+{
+	AllocationPhase phase ("update");
+	if (allocation_check)
+		AllocationTracker::Collect (&allocations_before);
+	static_geometry->UpdateProxies ();
+	contacts.clear ();
+	step_index++;
+	if (reorder_period && ++steps_since_reorder >= reorder_period)
+	{
+		ReorderBodies ();
+		steps_since_reorder = 0;
+	}
+
+	//bodies are split to chunks by their indexes only, so results don't depend on number of threads;
+	//bodies destroyed after integration make the last chunks shorter or empty
+	size_t chunks = (DynamicBodies.size () + chunk_bodies - 1) / chunk_bodies;
+	if (dynamic_pairs.size () < chunks)
+	{
+		dynamic_pairs.resize (chunks);
+		static_pairs.resize (chunks);
+	}
+	for (size_t chunk = chunks; chunk < dynamic_pairs.size (); chunk++)
+	{
+		dynamic_pairs[chunk].clear ();
+		static_pairs[chunk].clear ();
+	}
+
+	step_graph.Clear ();
+	//1st step: integration, constraints and bounding boxes; field of mutual gravity is found before integration
+	size_t gravity = mutual_gravity ? step_graph.Add ("gravity tree", 0, [this] () { BuildGravityTree (); }) : TaskGraph::null;
+	size_t broad_phase = step_graph.Add ("broad phase", 0, [this] () { UpdateBroadPhase (); });
+	for (size_t chunk = 0; chunk < chunks; chunk++)
+	{
+		size_t integrate = step_graph.Add ("integrate", chunk, [this, chunk] () { IntegrateBodies (chunk); });
+		step_graph.Depend (integrate, gravity);
+		step_graph.Depend (broad_phase, integrate);
+	}
+	for (size_t lattice = 0; lattice < LatticeBodies.size (); lattice++)
+		step_graph.Depend (broad_phase, step_graph.Add ("integrate lattice", lattice, [this, lattice] () { IntegrateLattice (lattice); }));
+	for (size_t rope = 0; rope < Ropes.size (); rope++)
+		step_graph.Depend (broad_phase, step_graph.Add ("integrate rope", rope, [this, rope] () { IntegrateRope (rope); }));
+	size_t integrate_particles = step_graph.Add ("integrate particles", 0, [this] () { IntegrateParticles (); });
+	step_graph.Depend (broad_phase, integrate_particles);
+	if (mutual_gravity)
+	{
+		size_t particle_chunks = (Particles.size () + chunk_particles - 1) / chunk_particles;
+		for (size_t chunk = 0; chunk < particle_chunks; chunk++)
+		{
+			size_t field = step_graph.Add ("particle gravity", chunk, [this, chunk] () { ParticleGravity (chunk); });
+			step_graph.Depend (field, gravity);
+			step_graph.Depend (integrate_particles, field);
+		}
+		step_graph.Depend (integrate_particles, gravity);
+	}
+
+	//2nd step: candidate pairs, narrow phase and serial response in order of pairs
+	size_t previous = broad_phase;
+	for (unsigned int cur_iteration = 0; cur_iteration < iterations; cur_iteration++)
+	{
+		bool first_iteration = cur_iteration == 0;
+		size_t response = step_graph.Add ("response", cur_iteration, [this, first_iteration] () { ResolvePairs (first_iteration); });
+		//function objects of tasks keep at most two words, so they are stored without allocation
+		for (size_t chunk = 0; chunk < chunks; chunk++)
+			for (int is_static = 0; is_static < 2; is_static++)
+			{
+				size_t pairs = is_static ?
+					step_graph.Add ("static pairs", chunk, [this, chunk] () { FindPairs (chunk, true); }) :
+					step_graph.Add ("dynamic pairs", chunk, [this, chunk] () { FindPairs (chunk, false); });
+				size_t narrow_phase = is_static ?
+					step_graph.Add ("static narrow phase", chunk, [this, chunk] () { CollidePairs (chunk, true); }) :
+					step_graph.Add ("dynamic narrow phase", chunk, [this, chunk] () { CollidePairs (chunk, false); });
+				step_graph.Depend (pairs, previous);
+				step_graph.Depend (narrow_phase, pairs);
+				step_graph.Depend (response, narrow_phase);
+			}
+		if (!chunks)
+			step_graph.Depend (response, previous);
+		previous = response;
+	}
+	step_graph.Depend (step_graph.Add ("finish", 0, [this] () { FinishStep (); }), previous);
+
+	step_graph.Run (pool.get (), task_timer);
+	if (allocation_check)
+		CheckAllocations ();
+}
 //----------end of implementation of physics----------------
\ No newline at end of file
@@ -5,8 +5,16 @@
 */
 #pragma once
 #include <vector>
+#include <memory>
 #include "vector.h"
 #include "boundingbox.h"
+#include "grid.h"
+#include "aabbtree.h"
+#include "arena.h"
+#include "threadpool.h"
+#include "taskgraph.h"
+#include "gravity.h"
+#include "allocation.h"
 
 /**
 @class
@@ -31,6 +39,30 @@ struct Point
 	@note variable gravity can be useful for central-force simulation
 	*/
 	void Update (double timestep, vector2d gravity);
+	/**
+	@brief Verlet integration with timestep that differs from previous one
+	@param timestep timestep of this integration
+	@param previous_timestep timestep of previous integration of point
+	@param gravity gravity for this point
+	@note velocity is preserved by scaling of displacement of previous step
+	*/
+	void Update (double timestep, double previous_timestep, vector2d gravity);
+};
+
+/**
+@class
+@brief massive particle; circle without internal constraints
+*/
+struct Particle : public Point
+{
+	double r;
+	/**
+	@brief constructor of particle
+	@param position current position of center
+	@param radius positive radius
+	@param mass positive mass
+	*/
+	Particle (vector2d position, double radius, double mass);
 };
 
 /**
@@ -43,6 +75,8 @@ struct Pole
 public:
 	size_t p1, p2;
 	double len;
+	/// accumulated lagrange multiplier of pole in XPBD mode; it's reset at every substep
+	double lambda;
 	/**
 	@brief constructor of point
 	@param point1, point2 iterators to points that should be connected
@@ -51,6 +85,42 @@ public:
 	Pole (size_t point1, size_t point2, double length);
 };
 
+/**
+@class
+@brief collision filter of body
+@note bodies of the same positive group always collide, bodies of the same negative group never collide;
+other bodies collide if category of every body is in mask of the other one
+*/
+struct CollisionFilter
+{
+	/// bits of categories of body
+	unsigned int category;
+	/// bits of categories that body collides with
+	unsigned int mask;
+	/// group of body; 0 - body is not in group
+	int group;
+	/**
+	@brief constructor of filter; by default body collides with all bodies
+	@param categories bits of categories of body
+	@param collides bits of categories that body collides with
+	@param group_index group of body
+	*/
+	CollisionFilter (unsigned int categories = 1, unsigned int collides = ~0u, int group_index = 0) :
+		category (categories),
+		mask (collides),
+		group (group_index)
+	{ }
+	/**
+	@return true, if body with this filter collides with body with other filter
+	*/
+	bool Collides (const CollisionFilter &other) const
+	{
+		if (group && group == other.group)
+			return group > 0;
+		return (mask & other.category) && (other.mask & category);
+	}
+};
+
 /**
 @class
 @brief Static Body shape
@@ -60,6 +130,10 @@ class StaticBody
 public:
 	std::vector<vector2d> points;
 	BoundingBox bbox;
+	/// leaf of body in broad phase tree
+	size_t proxy;
+	CollisionFilter filter;
+	StaticBody ();
 	/**
 	@brief adds vertex to figure; checks on convexity and orientation
 	@param point coordinates of vertex
@@ -74,6 +148,81 @@ public:
 	void ProjectToAxis (vector2d axis, double *min, double *max);
 };
 
+/**
+@class
+@brief static ground under open polyline; x of vertexes increases, ground is below the line
+@note segments under range of x are found by direct indexing of columns of equal width
+*/
+class Terrain
+{
+public:
+	std::vector<vector2d> points;
+	BoundingBox bbox;
+	CollisionFilter filter;
+	/**
+	@brief creates terrain from polyline
+	@param vertexes vertexes of polyline; at least 2, x must strictly increase
+	*/
+	Terrain (const std::vector<vector2d> &vertexes);
+	/**
+	@brief creates terrain from regularly sampled heights
+	@param x0 x of the first sample
+	@param step distance between samples by x
+	@param heights heights of samples; at least 2
+	*/
+	Terrain (double x0, double step, const std::vector<double> &heights);
+	/**
+	@brief finds segments of polyline that lie in range of x; O(1) plus number of segments
+	@param x1, x2 range of x
+	@param first, last pointers to indexes of first and last segments; segment k connects points k and k + 1
+	@return false, if range doesn't intersect terrain
+	*/
+	bool Segments (double x1, double x2, size_t *first, size_t *last) const;
+	/**
+	@return bytes of arrays of terrain
+	*/
+	size_t Memory () const
+	{
+		return points.capacity () * sizeof (vector2d) + columns.capacity () * sizeof (size_t);
+	}
+private:
+	double column_width;
+	/// index of the first segment that reaches every column
+	std::vector<size_t> columns;
+	/**
+	@brief checks polyline and builds columns and bounding box
+	*/
+	void Build ();
+};
+
+/**
+@class
+@brief static bodies of world with their broad phase tree
+@note geometry can be shared by several worlds; it must not be changed while any of them is updated
+*/
+class StaticGeometry
+{
+public:
+	std::vector<StaticBody> bodies;
+	std::vector<Terrain> terrains;
+	AABBTree tree;
+	/**
+	@brief puts new static bodies in tree and updates changed ones
+	@note tree is only read if all bodies are already in it, so worlds that share geometry can be updated in parallel
+	*/
+	void UpdateProxies ();
+};
+
+/**
+@brief set of poles that keeps shape of dynamic body
+*/
+enum Topology
+{
+	TOPOLOGY_FULL,		// pole between every pair of non-adjacent vertexes; O(n^2) poles
+	TOPOLOGY_SPARSE,	// poles of two triangulations of polygon; O(n) poles
+	TOPOLOGY_RIGID		// no poles; points are pulled to best-fit placement of rest shape
+};
+
 /**
 @class
 @brief Dynamic Body shape
@@ -82,16 +231,34 @@ class DynamicBody
 {
 public:
 	double stiffness;
+	/// compliance of poles and edges (inverse stiffness); negative - stiffness is used as relaxation factor (by default)
+	double compliance;
 	double mass;
-	std::vector<Point> points;
-	std::vector<Pole> poles;
-	std::vector<Pole> edges;
+	Topology topology;
+	ArenaVector<Point> points;
+	ArenaVector<Pole> poles;
+	ArenaVector<Pole> edges;
+	/// positions of points relative to center of mass in rest shape (only for rigid topology)
+	ArenaVector<vector2d> rest;
 	BoundingBox bbox;
+	/// leaf of body in broad phase tree
+	size_t proxy;
+	/// handle of body in world; it stays the same when body changes its index
+	size_t handle;
+	/// body is updated every 2^level steps of world with bigger timestep
+	unsigned int level;
+	/// timestep of last integration; 0 - body was not integrated yet
+	double last_timestep;
+	/// true, if body was integrated at current step of world
+	bool active;
+	CollisionFilter filter;
 	/**
 	@brief constructor of Dynamic Body
 	@param k stiffness of body
+	@param arena memory of points and poles; usually arena of world
+	@param type set of poles that will be generated by CalculateEdges ()
 	*/
-	DynamicBody (double k);
+	DynamicBody (double k, Arena *arena, Topology type = TOPOLOGY_FULL);
 	/**
 	@brief calculate new bounding box
 	*/
@@ -104,7 +271,7 @@ public:
 	*/
 	void AddDynamicPoint (Point point);
 	/**
-	@brief updates poles and edges
+	@brief updates poles and edges according to topology of body
 	@warning information about non-stretched lengths removes; method use current lengths between points
 	*/
 	void CalculateEdges ();
@@ -115,46 +282,518 @@ public:
 	*/
 	void ProjectToAxis (vector2d axis, double *min, double *max);
 	/**
-	@brief updates all poles and edges
+	@brief updates all poles and edges; rigid body is matched to its rest shape instead
 	*/
 	void UpdatePoles ();
+	/**
+	@brief solves poles and edges as compliant distance constraints (extended position based dynamics)
+	@param timestep timestep of integration before solving
+	@param iterations number of passes over poles and edges
+	@note result doesn't depend on timestep and converges to the same stiffness with iterations;
+	rigid body is matched to its rest shape once instead
+	*/
+	void SolvePoles (double timestep, unsigned int iterations);
+	/**
+	@brief pulls points to rest shape rotated and moved to best fit current positions; O(n)
+	@note stiffness is part of distance to goal position that point passes; 1 - absolutely rigid
+	*/
+	void MatchShape ();
+private:
+	/**
+	@brief adds poles of triangulation of polygon arc
+	@param first, last indexes of arc ends; last can be equal to number of points
+	@param offset shift of all indexes
+	@note chord of arc is not added
+	*/
+	void TriangulateArc (size_t first, size_t last, size_t offset);
+};
+
+/**
+@brief kind of distance constraint of lattice body
+*/
+enum LatticeConstraint
+{
+	LATTICE_STRUCTURAL,	// between neighbor points of row or column
+	LATTICE_SHEAR,		// along diagonals of cells
+	LATTICE_BENDING		// between points of row or column that have one point between them
+};
+
+/**
+@class
+@brief distance constraints of one kind that have no common points
+@note constraints are stored by arrays of their fields, so batch is solved by sequential pass over memory;
+constraints of batch don't depend on each other, so any ranges of batch can be solved in parallel
+*/
+struct ConstraintBatch
+{
+	LatticeConstraint kind;
+	std::vector<size_t> first, second;
+	std::vector<double> length;
+	/// accumulated lagrange multipliers; they are reset at every substep
+	std::vector<double> lambda;
+	/// true for points that are used by constraints of batch
+	std::vector<bool> used;
+};
+
+/**
+@class
+@brief soft body made of lattice of mass points (jelly or cloth with pinned points)
+@note constraints are solved as compliant distance constraints (extended position based dynamics) batch by batch;
+only outline of lattice collides: its points are circles of given radius and its edges are capsules of the same radius
+*/
+class LatticeBody
+{
+public:
+	std::vector<Point> points;
+	/// inverse masses of points; 0 - point is pinned
+	std::vector<double> inv_mass;
+	std::vector<ConstraintBatch> batches;
+	/// indexes of points of outline in counter-clockwise order
+	std::vector<size_t> boundary;
+	/// compliance (inverse stiffness) of every kind of constraint
+	double compliance[3];
+	/// radius of points and edges of outline
+	double radius;
+	BoundingBox bbox;
+	/**
+	@brief creates rectangular lattice with structural, shear and bending constraints
+	@param columns, rows numbers of points in row and in column; at least 2
+	@param origin position of left bottom point
+	@param cell distance between neighbor points
+	@param mass mass of every point
+	@param thickness radius of outline in collisions
+	*/
+	LatticeBody (size_t columns, size_t rows, vector2d origin, double cell, double mass, double thickness);
+	/**
+	@brief adds distance constraint with current distance between points as its length
+	@param p1, p2 indexes of points
+	@param kind kind of constraint; constraint is put to the first batch of its kind that doesn't use its points
+	*/
+	void AddConstraint (size_t p1, size_t p2, LatticeConstraint kind);
+	/**
+	@brief fixes point in its current position
+	*/
+	void Pin (size_t point);
+	/**
+	@brief sets compliance of kinds of constraints; 0 - absolutely stiff constraints
+	*/
+	void SetCompliance (double structural, double shear, double bending);
+	/**
+	@brief solves range of constraints of batch
+	@param batch index of batch
+	@param begin, end range of constraints of batch
+	@param alpha compliance of constraints divided by square of timestep
+	@note ranges of one batch can be solved by different threads at once
+	*/
+	void SolveBatch (size_t batch, size_t begin, size_t end, double alpha);
+	/**
+	@brief solves all constraints
+	@param timestep timestep of integration before solving
+	@param iterations number of passes over batches
+	*/
+	void Solve (double timestep, unsigned int iterations);
+	/**
+	@brief calculates bounding box of points enlarged by radius
+	*/
+	void RecalculateBBox ();
+	/**
+	@return bytes of arrays of body
+	*/
+	size_t Memory () const;
+};
+
+/**
+@class
+@brief rope or chain: open chain of mass points connected by links
+@note all links are solved at once by direct solution of tridiagonal system of linearized constraints
+(Thomas algorithm) in O(n), so long chain doesn't stretch like chain of poles solved by relaxation;
+points of rope collide as circles, links collide with vertexes of static bodies as capsules
+*/
+class Rope
+{
+public:
+	std::vector<Point> points;
+	/// inverse masses of points; 0 - point is pinned
+	std::vector<double> inv_mass;
+	/// rest lengths of links; link k connects points k and k + 1
+	std::vector<double> length;
+	/// compliance of links (inverse stiffness); 0 - inextensible rope (by default)
+	double compliance;
+	/// radius of points and links in collisions
+	double radius;
+	BoundingBox bbox;
+	/**
+	@brief creates straight rope
+	@param start, end positions of the first and the last points
+	@param links number of links; at least 1
+	@param mass mass of every point
+	@param thickness radius of rope in collisions
+	*/
+	Rope (vector2d start, vector2d end, size_t links, double mass, double thickness);
+	/**
+	@brief fixes point in its current position
+	*/
+	void Pin (size_t point);
+	/**
+	@brief solves links
+	@param timestep timestep of integration before solving
+	@param iterations number of direct solutions; every solution is exact for constraints linearized in current positions,
+	so one solution is enough for small steps
+	*/
+	void Solve (double timestep, unsigned int iterations);
+	/**
+	@brief calculates bounding box of points enlarged by radius
+	*/
+	void RecalculateBBox ();
+	/**
+	@return bytes of arrays of rope
+	*/
+	size_t Memory () const;
+private:
+	/// directions of links
+	std::vector<vector2d> direction;
+	/// accumulated lagrange multipliers of links; they are reset at every substep
+	std::vector<double> lambda;
+	/// upper diagonal and right side of system after forward sweep; memory is reused between steps
+	std::vector<double> upper, rhs;
+};
+
+/**
+@class
+@brief result of narrow phase collision detection
+@note all points are referenced by indexes in points array of corresponding body
+*/
+struct CollisionInfo
+{
+	double depth;
+	vector2d normal;
+	size_t edge_p1, edge_p2;
+	size_t point;
+	size_t edge_body, point_body;
+	vector2d static_point;
+	bool is_point;
+};
+
+/**
+@class
+@brief contact between pair of bodies that persists between steps
+@note second is index in StaticBodies array if is_static is set, otherwise in DynamicBodies
+*/
+struct Contact
+{
+	size_t first, second;
+	bool is_static;
+	CollisionInfo info;
+	double accumulated;
+	/**
+	@brief creates contact of pair without collision information
+	@param first_body, second_body indexes of bodies
+	@param static_pair true, if second body is static
+	*/
+	Contact (size_t first_body, size_t second_body, bool static_pair);
+	/**
+	@brief order of contacts in cache
+	*/
+	bool operator< (const Contact &b) const;
+	/**
+	@brief checks that contact was generated by the same features (edge and vertex) of bodies
+	@param b contact of the same pair
+	*/
+	bool SameFeature (const Contact &b) const;
+};
+
+/**
+@class
+@brief segment for ray casting
+*/
+struct Ray
+{
+	vector2d from, to;
+};
+
+/**
+@class
+@brief result of ray casting
+@note point = from + (to - from) * fraction; normal is outer normal of hit edge
+*/
+struct RayHit
+{
+	bool hit;
+	bool is_static;
+	size_t body;
+	double fraction;
+	vector2d point, normal;
+};
+
+/**
+@class
+@brief memory of world in bytes by kinds of objects
+*/
+struct MemoryStats
+{
+	/// array of dynamic bodies and blocks of arena with their points, poles, edges and rest shapes
+	size_t dynamic_bodies;
+	/// static bodies and their broad phase tree; static geometry can be shared by several worlds
+	size_t static_bodies;
+	size_t terrains;
+	/// particles, their grid and field of mutual gravity
+	size_t particles;
+	size_t lattice_bodies;
+	size_t ropes;
+	/// contacts of current step, contact cache and candidate pairs of chunks
+	size_t contacts;
+	/// broad phase tree of dynamic bodies, gravity tree, handles and buffers of reordering
+	size_t other;
+	/// free memory of arena
+	size_t arena_free;
+	/// sum of all fields
+	size_t total;
 };
 
 /**
 @class
 @brief physics engine
+@note world is not copyable, because bodies keep their points in memory of world
 */
 class Physics
 {
 private:
+	/// memory of dynamic bodies; blocks of destroyed bodies are reused by new ones
+	Arena arena;
+	std::shared_ptr<StaticGeometry> static_geometry;
 	double t;
 	vector2d a;
 	BoundingBox world_box;
+	double warm_start;
+	/// contacts of previous step sorted by pair
+	std::vector<Contact> contact_cache;
+	/// contacts of current step in order of resolving; every iteration adds its own contact of pair
+	std::vector<Contact> contacts;
+	/// indexes of contacts of current step sorted by pair and order of resolving
+	std::vector<size_t> contact_order;
 	/**
 	@brief collision detection between dynamic bodies
 	@param first, second indexes of bodies
 	@param info collision information if bodies intersect
 	@return true, if shapes intersect
 	*/
-	bool isDynamicDynamic (size_t first, size_t second);
+	bool isDynamicDynamic (size_t first, size_t second, CollisionInfo *info);
 	/**
 	@brief collision detection between static and dynamic bodies
 	@param dynamic_body, static_body indexes of bodies
 	@param info collision information if bodies intersect
 	@return true, if shapes intersect
 	*/
-	bool isDynamicStatic (size_t dynamic_body, size_t static_body);
+	bool isDynamicStatic (size_t dynamic_body, size_t static_body, CollisionInfo *info);
+	/**
+	@brief moves points of collided dynamic bodies apart
+	@param info collision information
+	@param depth distance of displacement along normal
+	*/
+	void ResolveDynamicDynamic (CollisionInfo *info, double depth);
+	/**
+	@brief moves points of dynamic body out of static body
+	@param dynamic_body index of body
+	@param info collision information
+	@param depth distance of displacement along normal
+	*/
+	void ResolveDynamicStatic (size_t dynamic_body, CollisionInfo *info, double depth);
+	/**
+	@brief applies correction that cached contact of the same feature accumulated on previous step
+	@param contact pair of bodies with collision information; its depth is reduced to residual penetration
+	@note correction is applied along cached normal and it is not more than current penetration
+	*/
+	void WarmStartContact (Contact *contact);
+	/**
+	@brief resolves detected collision and adds it to contacts of current step
+	@param contact pair of bodies with collision information
+	*/
+	void ResolveContact (Contact contact);
+	double ccd_threshold;
+	bool ccd;
+	/**
+	@brief moves fast dynamic body back along its path to the moment of first contact with static bodies
+	@param dynamic_body index of body
+	@note prevents tunneling through thin static bodies
+	*/
+	void ContinuousCollision (size_t dynamic_body);
+	AABBTree &static_tree;
+	AABBTree dynamic_tree;
+	/// enlargement of boxes of dynamic bodies in broad phase tree
+	double fat_margin;
+	/**
+	@brief updates leaf of dynamic body in broad phase tree, if body left its enlarged box
+	@param dynamic_body index of body
+	*/
+	void RefitProxy (size_t dynamic_body);
+	SpatialHash particle_grid;
+	double max_radius;
+	/// bodies whose boxes intersect box of all particles; found from trees every iteration
+	std::vector<size_t> particle_statics, particle_dynamics;
+	/**
+	@brief resolves collisions of particles with each other and with bodies
+	@note uses grid that is built once per step
+	*/
+	void CollideParticles ();
+	/// pool of threads of update; NULL - update runs in calling thread
+	std::unique_ptr<ThreadPool> pool;
+	TaskGraph step_graph;
+	TaskGraph::Timer task_timer;
+	/// candidate pairs of chunks of dynamic bodies; after narrow phase only colliding pairs are left
+	std::vector<std::vector<Contact> > dynamic_pairs, static_pairs;
+	/**
+	@brief integrates points, updates poles and bounding boxes of chunk of dynamic bodies
+	@param chunk index of chunk
+	*/
+	void IntegrateBodies (size_t chunk);
+	/**
+	@brief integrates particles and removes particles that left world
+	*/
+	void IntegrateParticles ();
+	/**
+	@brief removes bodies that left world, updates broad phase tree and grid of particles
+	*/
+	void UpdateBroadPhase ();
+	/**
+	@brief finds pairs of bodies of chunk whose bounding boxes intersect
+	@param chunk index of chunk
+	@param is_static true - pairs with static bodies, false - pairs with dynamic bodies of bigger indexes
+	*/
+	void FindPairs (size_t chunk, bool is_static);
+	/**
+	@brief narrow phase for candidate pairs of chunk
+	@param chunk index of chunk
+	@param is_static true - pairs with static bodies, false - pairs of dynamic bodies
+	*/
+	void CollidePairs (size_t chunk, bool is_static);
+	/**
+	@brief resolves collisions of all chunks in order of chunks and particles, then refits moved bodies in tree
+	@param first_iteration true, if contacts are warm-started before resolving
+	*/
+	void ResolvePairs (bool first_iteration);
+	/**
+	@brief merges contacts of iterations by pairs into cache
+	@note cached contact has feature and normal of the last iteration and correction of all iterations
+	*/
+	void FinishStep ();
+	/**
+	@brief pushes points of dynamic bodies of chunk and particles out of terrains
+	@param chunk index of chunk
+	*/
+	void CollideTerrains (size_t chunk);
+	/// index of body by slot of handle; null for free slots
+	std::vector<size_t> handle_index;
+	/// incremented when slot is freed, so old handles of slot become invalid
+	std::vector<size_t> handle_generation;
+	std::vector<size_t> free_handles;
+	/**
+	@brief gives handle to new dynamic body
+	@param dynamic_body index of body
+	*/
+	void CreateHandle (size_t dynamic_body);
+	unsigned int reorder_period, steps_since_reorder;
+	std::vector<std::pair<unsigned int, size_t> > reorder_keys;
+	std::vector<size_t> new_index;
+	std::vector<DynamicBody> reorder_buffer;
+	std::vector<Particle> particle_buffer;
+	/**
+	@brief sorts dynamic bodies and particles by Z-order curve of their positions
+	@note handles of bodies stay valid; indexes in cached contacts are changed
+	*/
+	void ReorderBodies ();
+	bool mutual_gravity;
+	double gravity_constant, gravity_theta, gravity_softening;
+	GravityTree gravity_tree;
+	/// field of mutual gravity in particles
+	std::vector<vector2d> particle_gravity;
+	/**
+	@brief builds tree of masses of all points and particles
+	*/
+	void BuildGravityTree ();
+	/**
+	@brief calculates field of mutual gravity in chunk of particles
+	@param chunk index of chunk
+	*/
+	void ParticleGravity (size_t chunk);
+	unsigned int substeps, constraint_iterations;
+	BoundingBox region;
+	double tier_distance;
+	unsigned int tiers;
+	size_t step_index;
+	/**
+	@return tier of body by its distance to region of interest
+	*/
+	unsigned int Tier (size_t dynamic_body);
+	/// candidate static and dynamic bodies of lattice body
+	std::vector<size_t> lattice_statics, lattice_dynamics;
+	/**
+	@brief integrates points of lattice body and solves its constraints
+	@param lattice index of body
+	*/
+	void IntegrateLattice (size_t lattice);
+	/**
+	@brief pushes outlines of lattice bodies out of static and dynamic bodies and terrains
+	@note pinned points are not moved; lattice bodies don't collide with each other and with particles
+	*/
+	void CollideLattices ();
+	/**
+	@brief collision of outline of lattice body with static or dynamic body
+	@param lattice index of lattice body
+	@param body index of static or dynamic body
+	@param is_static true, if body is static
+	*/
+	void CollideLattice (size_t lattice, size_t body, bool is_static);
+	/// candidate static bodies of rope
+	std::vector<size_t> rope_statics;
+	/**
+	@brief integrates points of rope and solves its links
+	@param rope index of rope
+	*/
+	void IntegrateRope (size_t rope);
+	/**
+	@brief pushes points and links of ropes out of static bodies and terrains
+	@note ropes don't collide with dynamic bodies, particles and each other
+	*/
+	void CollideRopes ();
+	bool allocation_check;
+	std::vector<AllocationCounter> allocations_before, allocations_after;
+	/**
+	@brief compares allocation counters with counters before update; fatal error, if update allocated
+	*/
+	void CheckAllocations ();
 public:
-	std::vector<StaticBody> StaticBodies;
+	/// bodies of static geometry of world
+	std::vector<StaticBody> &StaticBodies;
+	/// terrains of static geometry of world
+	std::vector<Terrain> &Terrains;
 	std::vector<DynamicBody> DynamicBodies;
+	std::vector<Particle> Particles;
+	std::vector<LatticeBody> LatticeBodies;
+	std::vector<Rope> Ropes;
 
 	/**
 	@brief constructor of physics engine
 	@param timestep step of simulation (in verlet integration must be constant)
 	@param gravity vector of gravity that applies to all bodies
 	@param world_size bounding box of world; when body leaves this box, it automatically deletes
+	@param statics static geometry shared with other worlds; world creates its own geometry by default
+	*/
+	Physics (double timestep, vector2d gravity, BoundingBox world_size,
+			 std::shared_ptr<StaticGeometry> statics = std::shared_ptr<StaticGeometry> ());
+	/**
+	@return step of simulation
 	*/
-	Physics (double timestep, vector2d gravity, BoundingBox world_size);
+	double GetTimestep ()
+	{
+		return t;
+	}
+	/**
+	@return static geometry of world; it can be passed to constructors of other worlds
+	*/
+	std::shared_ptr<StaticGeometry> GetStaticGeometry ()
+	{
+		return static_geometry;
+	}
 	/**
 	@brief adds static body to world
 	@param points_num number of points; must be at least 3
@@ -162,6 +801,26 @@ public:
 	*/
 	size_t AddStaticBody (size_t points_num, ...);
 	/**
+	@brief adds convex static body; vertexes are taken as is without check on convexity
+	@param points vertexes of convex polygon; at least 3
+	@return index of created body in StaticBodies array
+	*/
+	size_t AddStaticBody (const std::vector<vector2d> &points);
+	/**
+	@brief adds terrain that is open polyline
+	@param points vertexes with strictly increasing x; ground is below the line
+	@return index of terrain in Terrains array
+	*/
+	size_t AddTerrain (const std::vector<vector2d> &points);
+	/**
+	@brief adds terrain that is regularly sampled heightfield
+	@param x0 x of the first sample
+	@param step distance between samples
+	@param heights heights of samples
+	@return index of terrain in Terrains array
+	*/
+	size_t AddTerrain (double x0, double step, const std::vector<double> &heights);
+	/**
 	@brief adds dynamic body to world
 	@param stiffness stiffness of all poles in body
 	@param points_num number of points; must be at least 3
@@ -171,6 +830,199 @@ public:
 	*/
 	size_t AddDynamicBody (double stiffness, size_t points_num, ...);
 	/**
+	@brief adds dynamic body that is convex hull of unordered set of points; O(n log n)
+	@param stiffness stiffness of all poles in body
+	@param points mass points; at least 3; points inside of hull are ignored
+	@param topology set of poles of body
+	@return index of created body in DynamicBodies array
+	@warning it doesn't guarantee that this index will valid after Update method
+	*/
+	size_t AddDynamicBody (double stiffness, std::vector<Point> points, Topology topology = TOPOLOGY_FULL);
+	/**
+	@brief adds copy of dynamic body of other world; points, poles and rest shape are kept as they are
+	@param body body to copy
+	@return index of created body in DynamicBodies array
+	*/
+	size_t AddDynamicBody (const DynamicBody &body);
+	/**
+	@brief removes dynamic body from world; the last body takes its index
+	@param dynamic_body index of body
+	@note handles of other bodies stay valid
+	*/
+	void DestroyDynamicBody (size_t dynamic_body);
+	/**
+	@brief adds particle to world
+	@param position center of particle
+	@param radius radius of particle
+	@param mass mass of particle
+	@return index of created particle in Particles array
+	@warning particles are moved in array when other particles are destroyed in Update
+	*/
+	size_t AddParticle (vector2d position, double radius, double mass);
+	/**
+	@brief adds rectangular lattice soft body
+	@param columns, rows numbers of points in row and in column; at least 2
+	@param origin position of left bottom point
+	@param cell distance between neighbor points
+	@param mass mass of every point
+	@param thickness radius of outline in collisions
+	@return index of body in LatticeBodies array; compliance and pinned points are set through this array
+	@warning lattice body is removed from array when it leaves world
+	*/
+	size_t AddLatticeBody (size_t columns, size_t rows, vector2d origin, double cell, double mass, double thickness);
+	/**
+	@brief adds straight rope
+	@param start, end positions of the first and the last points
+	@param links number of links; at least 1
+	@param mass mass of every point
+	@param thickness radius of rope in collisions
+	@return index of rope in Ropes array; compliance and pinned points are set through this array
+	@warning rope is removed from array when it leaves world
+	*/
+	size_t AddRope (vector2d start, vector2d end, size_t links, double mass, double thickness);
+	/**
+	@brief finds bodies which bounding boxes intersect box
+	@param box query box
+	@param static_bodies, dynamic_bodies pointers to arrays for indexes of found bodies; can be NULL
+	@note broad phase is updated in Update method; bodies added after last update are not found
+	@note boxes of dynamic bodies in broad phase are enlarged by margin, so found bodies may not intersect box
+	*/
+	void QueryBodies (BoundingBox box, std::vector<size_t> *static_bodies, std::vector<size_t> *dynamic_bodies);
+	/**
+	@brief sets collision filter of many bodies at once
+	@param static_bodies, dynamic_bodies arrays of indexes of bodies (results of QueryBodies, for example)
+	@param filter filter of bodies
+	@note pairs are filtered in broad phase before narrow phase; terrains are filtered by their filter field
+	*/
+	void SetCollisionFilter (const std::vector<size_t> &static_bodies, const std::vector<size_t> &dynamic_bodies,
+							 CollisionFilter filter);
+	/**
+	@brief finds bodies that contain point
+	@param point coordinates of point
+	@param static_bodies, dynamic_bodies pointers to arrays for indexes of found bodies; can be NULL
+	*/
+	void QueryPoint (vector2d point, std::vector<size_t> *static_bodies, std::vector<size_t> *dynamic_bodies);
+	/**
+	@brief finds mass point of dynamic body that is the nearest to position
+	@param position coordinates of position
+	@param radius max distance to mass point
+	@param body, point pointers to indexes of found body and its point
+	@return true, if point was found
+	*/
+	bool FindNearestPoint (vector2d position, double radius, size_t *body, size_t *point);
+	/**
+	@brief finds the first intersection of segment with static and dynamic bodies
+	@param ray segment; bodies that contain its beginning are ignored
+	@param hit pointer to result
+	@return true, if segment hits any body
+	*/
+	bool RayCast (Ray ray, RayHit *hit);
+	/**
+	@brief casts many rays in parallel by chunks in pool of threads of world (see SetThreads)
+	@param rays array of segments
+	@param hits pointer to array of results; it is resized to number of rays
+	@warning world should not be changed during call, so it must not be called from Update
+	*/
+	void RayCast (const std::vector<Ray> &rays, std::vector<RayHit> *hits);
+	/**
+	@brief sets warm starting of persistent contacts
+	@param factor part of correction accumulated by contact on previous step that is applied along cached normal
+	before the first iteration, without max depth clamping; 0 disables warm starting
+	*/
+	void SetWarmStarting (double factor);
+	/**
+	@brief sets continuous collision detection between dynamic and static bodies
+	@param enabled true, if detection is enabled (by default)
+	@param min_displacement bodies whose points move less than this distance per step are not checked
+	@note min_displacement should be less than half of thickness of the thinnest static body
+	*/
+	void SetContinuousCollision (bool enabled, double min_displacement);
+	/**
+	@brief sets enlargement of dynamic bodies in broad phase
+	@param margin distance that body can move without update of broad phase tree
+	@note bigger margin means less updates of tree and more candidate pairs to check
+	*/
+	void SetBroadPhaseMargin (double margin);
+	/**
+	@return handle of dynamic body
+	@param dynamic_body index of body
+	*/
+	size_t GetHandle (size_t dynamic_body)
+	{
+		return DynamicBodies[dynamic_body].handle;
+	}
+	/**
+	@brief finds dynamic body by its handle
+	@param handle handle of body
+	@param dynamic_body pointer to current index of body
+	@return false, if body was destroyed
+	*/
+	bool FindBody (size_t handle, size_t *dynamic_body);
+	/**
+	@brief hashes bits of positions of points and particles, handles of bodies and cached contacts
+	@return 64-bit FNV-1a hash; equal hashes of two runs mean bitwise equal state
+	@note update is deterministic for any number of threads, so hash can check lockstep replicas and regressions
+	*/
+	unsigned long long StateHash ();
+	/**
+	@brief sets periodic sorting of bodies and particles in memory by their positions (Z-order curve)
+	@param period number of steps between sortings; 0 disables sorting (by default)
+	@note indexes of bodies and particles are changed by sorting; handles of bodies stay valid
+	*/
+	void SetReordering (unsigned int period);
+	/**
+	@brief sets gravitational attraction between all mass points and particles
+	@param enabled true, if mutual gravity is calculated; it is added to gravity of world
+	@param constant gravitational constant
+	@param theta accuracy of Barnes-Hut approximation; 0 - exact O(n^2) calculation, 0.5 by default
+	@param softening distance that smooths attraction of close points
+	@note tree of masses is built every step; field is calculated in tasks of update
+	*/
+	void SetMutualGravity (bool enabled, double constant, double theta, double softening);
+	/**
+	@brief sets solver of bodies with compliance (extended position based dynamics)
+	@param substeps number of substeps of integration and constraints in every step of body; 1 by default
+	@param iterations number of passes over constraints in every substep; 1 by default
+	@note stiffness of compliant bodies doesn't depend on timestep; more substeps or iterations only reduce error,
+	so they can be lowered for speed; bodies with negative compliance are solved by one relaxation pass per step
+	*/
+	void SetConstraintSolver (unsigned int substeps, unsigned int iterations);
+	/**
+	@brief sets region of interest; bodies far from it are updated less often with bigger timestep
+	@param box region of interest (view field of camera, for example)
+	@param distance width of ring around region for every tier
+	@param tiers number of tiers; body in tier k is updated every 2^k steps with timestep * 2^k; 0 disables tiers
+	@note bodies return to full rate as they approach region; inactive bodies are not collided with each other
+	*/
+	void SetRegionOfInterest (BoundingBox box, double distance, unsigned int tiers);
+	/**
+	@brief sets number of threads of update
+	@param threads number of threads; 1 - update runs in calling thread (by default), 0 - number of hardware threads
+	@note result of update is bitwise the same for any number of threads: chunks are made by indexes of bodies,
+	pairs are sorted in every chunk, and response, contact cache and all sums are done serially in order of chunks
+	*/
+	void SetThreads (unsigned int threads);
+	/**
+	@brief sets timing hook of tasks of update
+	@param timer function (name of task, chunk, seconds); it's called from threads of update
+	*/
+	void SetTaskTimer (TaskGraph::Timer timer);
+	/**
+	@brief calculates memory that world holds now
+	@param stats pointer to memory by kinds of objects
+	@note capacity of arrays is counted, so memory reserved by previous steps is included
+	*/
+	void GetMemoryStats (MemoryStats *stats);
+	/**
+	@brief sets check that update doesn't allocate heap memory
+	@param enabled true - every update that allocates is reported with its phases as fatal error
+	@note should be enabled after steps that fill arrays of world (steady state); it enables AllocationTracker
+	and needs program linked with allocation_hooks.cpp.
+	Allocations of update are counted by tasks of update; creation of bodies is counted in phases
+	"dynamic bodies", "static bodies", "terrains" and "particles"
+	*/
+	void SetAllocationCheck (bool enabled);
+	/**
 	@brief updates world; main method of simulation
 	@param iterations number of resolve iterations
 	*/
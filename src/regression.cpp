@@ -0,0 +1,125 @@
+/**
+@file
+@brief checks of cases that were broken once
+@author Sergei Kachkov
+@note usage: physics_regression; every check prints its result; exit code is not zero if any check fails
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "physics.h"
+
+static const double timestep = 0.002;
+
+/**
+@brief adds square body with all points moving with the same velocity
+*/
+static size_t add_box (Physics *world, vector2d corner, double size, vector2d velocity)
+{
+	std::vector<Point> points;
+	points.push_back (Point (corner, 1.0));
+	points.push_back (Point (corner + vector2d (size, 0), 1.0));
+	points.push_back (Point (corner + vector2d (size, size), 1.0));
+	points.push_back (Point (corner + vector2d (0, size), 1.0));
+	for (size_t i = 0; i < points.size (); i++)
+		points[i].old_pos = points[i].cur_pos - velocity * timestep;
+	return world->AddDynamicBody (1.0, points);
+}
+
+/**
+@brief fast box falls on thin plate alone or on box that lies on plate; collision response moves bodies farther
+than margin of their leaves in tree during step, so pairs must be found with refit leaves in every iteration
+@return true, if no point of bodies went through the middle of plate
+*/
+static bool check_thin_static ()
+{
+	const double thickness = 0.05, speeds[] = {20, 40, 60, 80};
+	bool passed = true;
+	for (size_t boxes = 1; boxes <= 2; boxes++)
+		for (size_t k = 0; k < sizeof (speeds) / sizeof (speeds[0]); k++)
+		{
+			Physics world (timestep, vector2d (0, -10), BoundingBox (vector2d (-100, -100), vector2d (100, 100)));
+			world.SetContinuousCollision (true, thickness * 0.4);
+			world.AddStaticBody (4, vector2d (-3, 0), vector2d (3, 0), vector2d (3, thickness), vector2d (-3, thickness));
+			if (boxes == 2)
+				add_box (&world, vector2d (-0.15, thickness), 0.3, vector2d (0, 0));
+			add_box (&world, vector2d (-0.15, thickness + 0.02 + (boxes - 1) * 0.3), 0.3, vector2d (0, -speeds[k]));
+			double lowest = thickness;
+			for (int step = 0; step < 300; step++)
+			{
+				world.Update (16);
+				for (size_t i = 0; i < world.DynamicBodies.size (); i++)
+					for (size_t j = 0; j < world.DynamicBodies[i].points.size (); j++)
+						lowest = std::min (lowest, world.DynamicBodies[i].points[j].cur_pos.y);
+			}
+			if (world.DynamicBodies.size () != boxes || lowest < thickness * 0.5)
+			{
+				printf ("thin static: %u boxes at speed %g went through plate, lowest point %g\n",
+						(unsigned int)boxes, speeds[k], lowest);
+				passed = false;
+			}
+		}
+	return passed;
+}
+
+/**
+@brief bodies are added far from region of interest at step where tier can be coarsened; at the first step of body
+its displacement is not scaled by previous timestep
+@return true, if fast body stays in tier of every step and resting body goes to slower tier
+*/
+static bool check_first_step_tier ()
+{
+	Physics world (timestep, vector2d (0, -10), BoundingBox (vector2d (-100, -100), vector2d (100, 100)));
+	world.SetRegionOfInterest (BoundingBox (vector2d (-1, -1), vector2d (1, 1)), 3.0, 2);
+	world.Update (8);
+	size_t fast = add_box (&world, vector2d (50, 50), 0.3, vector2d (10, 0));
+	size_t resting = add_box (&world, vector2d (-50, 50), 0.3, vector2d (0, 0));
+	world.Update (8);
+	if (world.DynamicBodies[fast].level != 0 || world.DynamicBodies[resting].level != 1)
+	{
+		printf ("first step tier: fast body has tier %u, resting body has tier %u\n",
+				world.DynamicBodies[fast].level, world.DynamicBodies[resting].level);
+		return false;
+	}
+	return true;
+}
+
+/**
+@brief boxes and particles settle on ground, then update is checked for heap allocations
+@return true; allocating update stops program with fatal error
+*/
+static bool check_steady_allocations ()
+{
+	Physics world (timestep, vector2d (0, -10), BoundingBox (vector2d (-100, -100), vector2d (100, 100)));
+	world.AddStaticBody (4, vector2d (-50, -1), vector2d (50, -1), vector2d (50, 0), vector2d (-50, 0));
+	for (int i = 0; i < 2; i++)
+		for (int j = 0; j < 30; j++)
+			add_box (&world, vector2d (-7 + j * 0.47 + i * 0.1, 0.35 + i * 0.45), 0.3, vector2d (0, 0));
+	for (int i = 0; i < 50; i++)
+		world.AddParticle (vector2d (-5 + i * 0.2, 8), 0.05, 0.1);
+	world.SetThreads (4);
+	for (int step = 0; step < 2000; step++)
+		world.Update (4);
+	world.SetAllocationCheck (true);
+	for (int step = 0; step < 500; step++)
+		world.Update (4);
+	return true;
+}
+
+int main (int argc, char *argv[])
+{
+	InitLog ();
+	bool passed = true;
+	if (check_thin_static ())
+		printf ("thin static: passed\n");
+	else
+		passed = false;
+	if (check_first_step_tier ())
+		printf ("first step tier: passed\n");
+	else
+		passed = false;
+	if (check_steady_allocations ())
+		printf ("steady allocations: passed\n");
+	CloseLog ();
+	return passed ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,88 @@
+/**
+@file
+@brief implementation of separating axis test on many axes at once
+@author Sergei Kachkov
+*/
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "sat.h"
+
+void SatKernel::Clear ()
+{
+	for (int i = 0; i < 2; i++)
+	{
+		x[i].clear ();
+		y[i].clear ();
+	}
+	axis_x.clear ();
+	axis_y.clear ();
+}
+
+bool SatKernel::MinOverlap (size_t *axis, double *depth, double *first_max, double *second_max)
+{
+	size_t axes_num = axis_x.size ();
+	*depth = DBL_MAX;
+	//odd axis is paired with copy of itself
+	if (axes_num % 2)
+	{
+		axis_x.push_back (axis_x.back ());
+		axis_y.push_back (axis_y.back ());
+	}
+	for (size_t a = 0; a < axes_num; a += 2)
+	{
+		//min and max projections of polygons on pair of axes
+		double min[2][2], max[2][2];
+		for (int polygon = 0; polygon < 2; polygon++)
+		{
+			const double *px = x[polygon].data (), *py = y[polygon].data ();
+			size_t n = x[polygon].size ();
+#ifdef __SSE2__
+			__m128d ax = _mm_loadu_pd (&axis_x[a]), ay = _mm_loadu_pd (&axis_y[a]);
+			__m128d low = _mm_set1_pd (DBL_MAX), high = _mm_set1_pd (-DBL_MAX);
+			for (size_t i = 0; i < n; i++)
+			{
+				__m128d projection = _mm_add_pd (_mm_mul_pd (ax, _mm_set1_pd (px[i])), _mm_mul_pd (ay, _mm_set1_pd (py[i])));
+				low = _mm_min_pd (low, projection);
+				high = _mm_max_pd (high, projection);
+			}
+			_mm_storeu_pd (min[polygon], low);
+			_mm_storeu_pd (max[polygon], high);
+#else
+			for (int k = 0; k < 2; k++)
+			{
+				min[polygon][k] = DBL_MAX;
+				max[polygon][k] = -DBL_MAX;
+				for (size_t i = 0; i < n; i++)
+				{
+					double projection = axis_x[a + k] * px[i] + axis_y[a + k] * py[i];
+					if (max[polygon][k] < projection)
+						max[polygon][k] = projection;
+					if (min[polygon][k] > projection)
+						min[polygon][k] = projection;
+				}
+			}
+#endif
+		}
+		for (size_t k = 0; k < 2 && a + k < axes_num; k++)
+		{
+			double distance = (min[0][k] < min[1][k]) ? min[1][k] - max[0][k] : min[0][k] - max[1][k];
+			if (distance > -DBL_MIN)
+			{
+				axis_x.resize (axes_num);
+				axis_y.resize (axes_num);
+				return false;
+			}
+			if (-distance < *depth)
+			{
+				*depth = -distance;
+				*axis = a + k;
+				*first_max = max[0][k];
+				*second_max = max[1][k];
+			}
+		}
+	}
+	axis_x.resize (axes_num);
+	axis_y.resize (axes_num);
+	return true;
+}
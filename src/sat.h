@@ -0,0 +1,62 @@
+/**
+@file
+@brief separating axis test of pair of convex polygons on many axes at once
+@author Sergei Kachkov
+*/
+#pragma once
+#include <vector>
+#include "vector.h"
+
+/**
+@class
+@brief vertexes and candidate axes of pair of convex polygons in structure-of-arrays layout
+@note both vertex sets are loaded once and projected on two axes per SSE2 instruction (scalar code without SSE2);
+projections are calculated by the same operations as ProjectToAxis methods, so results are bitwise the same;
+arrays are reused between calls, so narrow phase doesn't allocate memory in steady state
+*/
+class SatKernel
+{
+private:
+	std::vector<double> x[2], y[2];
+	std::vector<double> axis_x, axis_y;
+public:
+	/**
+	@brief removes vertexes and axes of previous pair
+	*/
+	void Clear ();
+	/**
+	@brief adds vertex to polygon
+	@param polygon 0 - the first polygon, 1 - the second one
+	*/
+	void AddVertex (int polygon, vector2d vertex)
+	{
+		x[polygon].push_back (vertex.x);
+		y[polygon].push_back (vertex.y);
+	}
+	/**
+	@brief adds normal of edge as candidate axis
+	@param p1, p2 ends of edge
+	*/
+	void AddEdge (vector2d p1, vector2d p2)
+	{
+		vector2d axis (p2.y - p1.y, p1.x - p2.x);
+		axis = axis.norm ();
+		axis_x.push_back (axis.x);
+		axis_y.push_back (axis.y);
+	}
+	/**
+	@return axis by its index in order of adding
+	*/
+	vector2d Axis (size_t axis)
+	{
+		return vector2d (axis_x[axis], axis_y[axis]);
+	}
+	/**
+	@brief projects both polygons on all axes and finds axis of the smallest overlap
+	@param axis pointer to index of axis; the first one is taken of axes with equal overlaps
+	@param depth pointer to overlap of projections on axis
+	@param first_max, second_max pointers to max projections of polygons on axis
+	@return false, if polygons are separated by one of axes
+	*/
+	bool MinOverlap (size_t *axis, double *depth, double *first_max, double *second_max);
+};
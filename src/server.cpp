@@ -0,0 +1,728 @@
+/**
+@file
+@brief implementation of streaming of world state
+@author Sergei Kachkov
+*/
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <algorithm>
+#include "server.h"
+
+/// max length of command message; the longest command is drag (2 varints and 2 doubles)
+static const unsigned int max_command_length = 64;
+/// max length of message of server
+static const unsigned int max_server_length = 1u << 30;
+
+//----------encoding of messages---------------------------
+static void put_varint (std::string *out, unsigned long long value)
+{
+	while (value >= 0x80)
+	{
+		out->push_back ((char)(value | 0x80));
+		value >>= 7;
+	}
+	out->push_back ((char)value);
+}
+
+static void put_signed (std::string *out, long long value)
+{
+	put_varint (out, ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63));
+}
+
+static void put_double (std::string *out, double value)
+{
+	out->append ((const char *)&value, sizeof (double));
+}
+
+static bool get_varint (const std::string &in, size_t *pos, unsigned long long *value)
+{
+	*value = 0;
+	for (int shift = 0; *pos < in.size () && shift < 64; shift += 7)
+	{
+		unsigned char byte = (unsigned char)in[(*pos)++];
+		*value |= (unsigned long long)(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+	return false;
+}
+
+static bool get_size (const std::string &in, size_t *pos, size_t *value)
+{
+	unsigned long long v;
+	if (!get_varint (in, pos, &v))
+		return false;
+	*value = (size_t)v;
+	return true;
+}
+
+static bool get_signed (const std::string &in, size_t *pos, long long *value)
+{
+	unsigned long long v;
+	if (!get_varint (in, pos, &v))
+		return false;
+	*value = (long long)(v >> 1) ^ -(long long)(v & 1);
+	return true;
+}
+
+static bool get_double (const std::string &in, size_t *pos, double *value)
+{
+	if (*pos + sizeof (double) > in.size ())
+		return false;
+	memcpy (value, in.data () + *pos, sizeof (double));
+	*pos += sizeof (double);
+	return true;
+}
+
+static void put_polylines (std::string *out, const std::vector<std::vector<vector2d> > &polylines)
+{
+	put_varint (out, polylines.size ());
+	for (size_t i = 0; i < polylines.size (); i++)
+	{
+		put_varint (out, polylines[i].size ());
+		for (size_t j = 0; j < polylines[i].size (); j++)
+		{
+			put_double (out, polylines[i][j].x);
+			put_double (out, polylines[i][j].y);
+		}
+	}
+}
+
+/**
+@brief reads polylines; numbers of polylines and points are checked against rest of payload before allocation
+*/
+static bool get_polylines (const std::string &in, size_t *pos, std::vector<std::vector<vector2d> > *polylines)
+{
+	size_t polylines_num, points_num;
+	polylines->clear ();
+	//every polyline takes at least one byte of number of points
+	if (!get_size (in, pos, &polylines_num) || polylines_num > in.size () - *pos)
+		return false;
+	polylines->resize (polylines_num);
+	for (size_t i = 0; i < polylines_num; i++)
+	{
+		if (!get_size (in, pos, &points_num) || points_num > (in.size () - *pos) / (2 * sizeof (double)))
+			return false;
+		(*polylines)[i].resize (points_num);
+		for (size_t j = 0; j < points_num; j++)
+		{
+			get_double (in, pos, &(*polylines)[i][j].x);
+			get_double (in, pos, &(*polylines)[i][j].y);
+		}
+	}
+	return true;
+}
+
+static void put_message (std::string *out, unsigned char type, const std::string &payload)
+{
+	unsigned int length = (unsigned int)payload.size () + 1;
+	out->append ((const char *)&length, sizeof (length));
+	out->push_back ((char)type);
+	out->append (payload);
+}
+
+/**
+@brief takes complete messages from the beginning of buffer
+@param max_length max length of message; longer message is not buffered till its end
+@param callback function (type, payload)
+@return false, if buffer has message of zero length or longer than max length
+*/
+template <class Callback>
+static bool take_messages (std::string *in, unsigned int max_length, Callback callback)
+{
+	size_t pos = 0;
+	unsigned int length;
+	bool valid = true;
+	while (in->size () - pos >= sizeof (length))
+	{
+		memcpy (&length, in->data () + pos, sizeof (length));
+		if (!length || length > max_length)
+		{
+			valid = false;
+			break;
+		}
+		if (in->size () - pos - sizeof (length) < length)
+			break;
+		callback ((unsigned char)(*in)[pos + sizeof (length)], in->substr (pos + sizeof (length) + 1, length - 1));
+		pos += sizeof (length) + length;
+	}
+	in->erase (0, pos);
+	return valid;
+}
+
+static void set_nonblocking (int socket)
+{
+	fcntl (socket, F_SETFL, fcntl (socket, F_GETFL, 0) | O_NONBLOCK);
+}
+//----------end of encoding of messages--------------------
+
+//----------implementation of snapshot---------------------
+Snapshot::Snapshot () :
+	frame (0)
+{
+	offsets.push_back (0);
+}
+
+void Snapshot::Clear ()
+{
+	frame = 0;
+	handles.clear ();
+	offsets.resize (1);
+	coords.clear ();
+}
+
+size_t Snapshot::Find (size_t handle) const
+{
+	std::vector<size_t>::const_iterator it = std::lower_bound (handles.begin (), handles.end (), handle);
+	if (it == handles.end () || *it != handle)
+		return handles.size ();
+	return it - handles.begin ();
+}
+//----------end of implementation of snapshot--------------
+
+//----------implementation of state server-----------------
+StateServer::StateServer (double quantum, size_t history) :
+	listener (-1),
+	quantum (quantum),
+	frame (0),
+	history (std::max (history, (size_t)2))
+{
+}
+
+StateServer::~StateServer ()
+{
+	for (size_t i = 0; i < clients.size (); i++)
+		close (clients[i].socket);
+	if (listener >= 0)
+		close (listener);
+	if (!unix_path.empty ())
+		unlink (unix_path.c_str ());
+}
+
+void StateServer::ListenUnix (const char *path)
+{
+	sockaddr_un address;
+	memset (&address, 0, sizeof (address));
+	address.sun_family = AF_UNIX;
+	if (strlen (path) >= sizeof (address.sun_path))
+		log (LOG_FAIL, "path of socket %s is too long", path);
+	strcpy (address.sun_path, path);
+	unlink (path);
+	listener = socket (AF_UNIX, SOCK_STREAM, 0);
+	if (listener < 0 || bind (listener, (sockaddr *)&address, sizeof (address)) || listen (listener, 16))
+		log (LOG_FAIL, "can not listen on socket %s", path);
+	unix_path = path;
+	set_nonblocking (listener);
+	log (LOG_INFO, "server listens on socket %s", path);
+}
+
+void StateServer::ListenTcp (unsigned short port)
+{
+	sockaddr_in address;
+	memset (&address, 0, sizeof (address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl (INADDR_ANY);
+	address.sin_port = htons (port);
+	listener = socket (AF_INET, SOCK_STREAM, 0);
+	int reuse = 1;
+	if (listener >= 0)
+		setsockopt (listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof (reuse));
+	if (listener < 0 || bind (listener, (sockaddr *)&address, sizeof (address)) || listen (listener, 16))
+		log (LOG_FAIL, "can not listen on port %u", port);
+	set_nonblocking (listener);
+	log (LOG_INFO, "server listens on port %u", port);
+}
+
+void StateServer::Accept ()
+{
+	int socket;
+	while ((socket = accept (listener, NULL, NULL)) >= 0)
+	{
+		set_nonblocking (socket);
+		//frames are small and should leave at once
+		int no_delay = 1;
+		setsockopt (socket, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof (no_delay));
+		Client client;
+		client.socket = socket;
+		client.acked = 0;
+		client.hello = false;
+		clients.push_back (client);
+		log (LOG_INFO, "client connected; clients: %u", clients.size ());
+	}
+}
+
+bool StateServer::Flush (Client &client)
+{
+	while (!client.output.empty ())
+	{
+		ssize_t sent = send (client.socket, client.output.data (), client.output.size (), MSG_NOSIGNAL);
+		if (sent < 0)
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+		client.output.erase (0, sent);
+	}
+	return true;
+}
+
+bool StateServer::Read (Client &client)
+{
+	char buffer[4096];
+	while (true)
+	{
+		ssize_t received = recv (client.socket, buffer, sizeof (buffer), 0);
+		if (received == 0)
+			return false;
+		if (received < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				return false;
+			break;
+		}
+		client.input.append (buffer, received);
+	}
+	//client that sends too long message is disconnected, so its input doesn't grow without limit
+	return take_messages (&client.input, max_command_length, [this, &client] (unsigned char type, const std::string &payload)
+	{
+		Parse (client, type, payload);
+	});
+}
+
+void StateServer::Parse (Client &client, unsigned char type, const std::string &payload)
+{
+	size_t pos = 0;
+	Command command;
+	command.type = (MessageType)type;
+	command.handle = command.point = 0;
+	command.size = 0.0;
+	switch (type)
+	{
+	case MESSAGE_ACK:
+		{
+			size_t acked;
+			if (get_size (payload, &pos, &acked) && acked <= frame && acked > client.acked)
+				client.acked = acked;
+		}
+		break;
+	case MESSAGE_SPAWN:
+		if (get_double (payload, &pos, &command.position.x) && get_double (payload, &pos, &command.position.y) &&
+			get_double (payload, &pos, &command.size) && command.size > 0.0)
+			commands.push_back (command);
+		break;
+	case MESSAGE_DRAG:
+		if (get_size (payload, &pos, &command.handle) && get_size (payload, &pos, &command.point) &&
+			get_double (payload, &pos, &command.position.x) && get_double (payload, &pos, &command.position.y))
+			commands.push_back (command);
+		break;
+	}
+}
+
+void StateServer::Poll (int timeout)
+{
+	std::vector<pollfd> sockets (clients.size () + 1);
+	sockets[0].fd = listener;
+	sockets[0].events = POLLIN;
+	for (size_t i = 0; i < clients.size (); i++)
+	{
+		sockets[i + 1].fd = clients[i].socket;
+		sockets[i + 1].events = POLLIN | (clients[i].output.empty () ? 0 : POLLOUT);
+	}
+	if (poll (sockets.data (), sockets.size (), timeout) <= 0)
+		return;
+
+	//clients are removed from the end, so indexes of sockets stay valid
+	for (size_t i = clients.size (); i-- > 0;)
+	{
+		short events = sockets[i + 1].revents;
+		bool connected = !(events & (POLLERR | POLLNVAL));
+		if (connected && (events & (POLLIN | POLLHUP)))
+			connected = Read (clients[i]);
+		if (connected && (events & POLLOUT))
+			connected = Flush (clients[i]);
+		if (!connected)
+		{
+			close (clients[i].socket);
+			clients.erase (clients.begin () + i);
+			log (LOG_INFO, "client disconnected; clients: %u", clients.size ());
+		}
+	}
+	if (listener >= 0 && (sockets[0].revents & POLLIN))
+		Accept ();
+}
+
+void StateServer::ApplyCommands (Physics &world)
+{
+	for (size_t i = 0; i < commands.size (); i++)
+	{
+		Command &command = commands[i];
+		size_t body;
+		if (command.type == MESSAGE_SPAWN)
+		{
+			double half = command.size * 0.5;
+			vector2d center = command.position;
+			world.AddDynamicBody (0.1, 4, Point (center + vector2d (-half, -half), 1.0),
+								  Point (center + vector2d (half, -half), 1.0),
+								  Point (center + vector2d (half, half), 1.0),
+								  Point (center + vector2d (-half, half), 1.0));
+		}
+		else if (command.type == MESSAGE_DRAG && world.FindBody (command.handle, &body) &&
+				 command.point < world.DynamicBodies[body].points.size ())
+			world.DynamicBodies[body].points[command.point].cur_pos = command.position;
+	}
+	commands.clear ();
+}
+
+void StateServer::Hello (Physics &world, std::string *message)
+{
+	std::string payload;
+	put_double (&payload, quantum);
+	put_double (&payload, world.GetTimestep ());
+	std::vector<std::vector<vector2d> > polylines (world.StaticBodies.size ());
+	for (size_t i = 0; i < world.StaticBodies.size (); i++)
+		polylines[i] = world.StaticBodies[i].points;
+	put_polylines (&payload, polylines);
+	polylines.resize (world.Terrains.size ());
+	for (size_t i = 0; i < world.Terrains.size (); i++)
+		polylines[i] = world.Terrains[i].points;
+	put_polylines (&payload, polylines);
+	put_message (message, MESSAGE_HELLO, payload);
+}
+
+void StateServer::Encode (const Snapshot &current, const Snapshot *base, std::string *message)
+{
+	std::string changes, removed;
+	size_t changed_num = 0, removed_num = 0;
+	size_t j = 0;
+	for (size_t i = 0; i < current.Size (); i++)
+	{
+		size_t handle = current.handles[i];
+		//bodies of base that are absent in current frame were destroyed
+		for (; base && j < base->Size () && base->handles[j] < handle; j++, removed_num++)
+			put_varint (&removed, base->handles[j]);
+		const long long *coords = &current.coords[current.offsets[i]];
+		size_t coords_num = current.offsets[i + 1] - current.offsets[i];
+		const long long *base_coords = NULL;
+		if (base && j < base->Size () && base->handles[j] == handle)
+		{
+			if (base->offsets[j + 1] - base->offsets[j] == coords_num)
+				base_coords = &base->coords[base->offsets[j]];
+			j++;
+		}
+		if (base_coords && std::equal (coords, coords + coords_num, base_coords))
+			continue;
+		changed_num++;
+		put_varint (&changes, handle);
+		put_varint (&changes, coords_num + (base_coords ? 1 : 0));
+		for (size_t k = 0; k < coords_num; k++)
+			put_signed (&changes, coords[k] - (base_coords ? base_coords[k] : 0));
+	}
+	for (; base && j < base->Size (); j++, removed_num++)
+		put_varint (&removed, base->handles[j]);
+
+	std::string payload;
+	put_varint (&payload, current.frame);
+	put_varint (&payload, base ? base->frame : 0);
+	put_varint (&payload, changed_num);
+	payload.append (changes);
+	put_varint (&payload, removed_num);
+	payload.append (removed);
+	put_message (message, MESSAGE_FRAME, payload);
+}
+
+void StateServer::Broadcast (Physics &world)
+{
+	frame++;
+	Snapshot &current = history[frame % history.size ()];
+	current.Clear ();
+	current.frame = frame;
+	order.resize (world.DynamicBodies.size ());
+	for (size_t i = 0; i < order.size (); i++)
+		order[i] = i;
+	std::sort (order.begin (), order.end (), [&world] (size_t a, size_t b)
+	{
+		return world.DynamicBodies[a].handle < world.DynamicBodies[b].handle;
+	});
+	for (size_t i = 0; i < order.size (); i++)
+	{
+		DynamicBody &body = world.DynamicBodies[order[i]];
+		current.handles.push_back (body.handle);
+		for (size_t j = 0; j < body.points.size (); j++)
+		{
+			current.coords.push_back (llround (body.points[j].cur_pos.x / quantum));
+			current.coords.push_back (llround (body.points[j].cur_pos.y / quantum));
+		}
+		current.offsets.push_back (current.coords.size ());
+	}
+
+	//clients with the same base get the same frame, so it is encoded once
+	encoded.clear ();
+	std::string hello;
+	for (size_t i = clients.size (); i-- > 0;)
+	{
+		Client &client = clients[i];
+		if (!client.hello)
+		{
+			if (hello.empty ())
+				Hello (world, &hello);
+			client.output.append (hello);
+			client.hello = true;
+		}
+		//client that hasn't received previous data skips frame
+		if (!client.output.empty () && !Flush (client))
+			continue;
+		if (client.output.empty ())
+		{
+			const Snapshot *base = NULL;
+			if (client.acked && frame - client.acked < history.size () && history[client.acked % history.size ()].frame == client.acked)
+				base = &history[client.acked % history.size ()];
+			size_t base_frame = base ? base->frame : 0;
+			std::map<size_t, std::string>::iterator message = encoded.find (base_frame);
+			if (message == encoded.end ())
+			{
+				message = encoded.insert (std::make_pair (base_frame, std::string ())).first;
+				Encode (current, base, &message->second);
+			}
+			client.output = message->second;
+		}
+		if (!Flush (client))
+		{
+			close (client.socket);
+			clients.erase (clients.begin () + i);
+			log (LOG_INFO, "client disconnected; clients: %u", clients.size ());
+		}
+	}
+}
+//----------end of implementation of state server----------
+
+//----------implementation of state client-----------------
+StateClient::StateClient (size_t history) :
+	socket (-1),
+	history (std::max (history, (size_t)2)),
+	quantum (1.0),
+	timestep (0.0),
+	frame (0),
+	frame_bytes (0)
+{
+}
+
+StateClient::~StateClient ()
+{
+	if (socket >= 0)
+		close (socket);
+}
+
+bool StateClient::ConnectUnix (const char *path)
+{
+	sockaddr_un address;
+	memset (&address, 0, sizeof (address));
+	address.sun_family = AF_UNIX;
+	if (strlen (path) >= sizeof (address.sun_path))
+		return false;
+	strcpy (address.sun_path, path);
+	socket = ::socket (AF_UNIX, SOCK_STREAM, 0);
+	if (socket < 0 || connect (socket, (sockaddr *)&address, sizeof (address)))
+		return false;
+	set_nonblocking (socket);
+	return true;
+}
+
+bool StateClient::ConnectTcp (const char *host, unsigned short port)
+{
+	addrinfo hints, *addresses;
+	memset (&hints, 0, sizeof (hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo (host, NULL, &hints, &addresses))
+		return false;
+	sockaddr_in address = *(sockaddr_in *)addresses->ai_addr;
+	freeaddrinfo (addresses);
+	address.sin_port = htons (port);
+	socket = ::socket (AF_INET, SOCK_STREAM, 0);
+	if (socket < 0 || connect (socket, (sockaddr *)&address, sizeof (address)))
+		return false;
+	int no_delay = 1;
+	setsockopt (socket, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof (no_delay));
+	set_nonblocking (socket);
+	return true;
+}
+
+void StateClient::Send (unsigned char type, const std::string &payload)
+{
+	put_message (&output, type, payload);
+	while (!output.empty ())
+	{
+		ssize_t sent = send (socket, output.data (), output.size (), MSG_NOSIGNAL);
+		if (sent < 0)
+			break;
+		output.erase (0, sent);
+	}
+}
+
+void StateClient::Parse (unsigned char type, const std::string &payload)
+{
+	size_t pos = 0;
+	if (type == MESSAGE_HELLO)
+	{
+		//state is replaced only by complete message
+		double new_quantum, new_timestep;
+		std::vector<std::vector<vector2d> > new_statics, new_terrains;
+		if (get_double (payload, &pos, &new_quantum) && get_double (payload, &pos, &new_timestep) && new_quantum > 0.0 &&
+			get_polylines (payload, &pos, &new_statics) && get_polylines (payload, &pos, &new_terrains))
+		{
+			quantum = new_quantum;
+			timestep = new_timestep;
+			statics.swap (new_statics);
+			terrains.swap (new_terrains);
+		}
+		return;
+	}
+	if (type != MESSAGE_FRAME)
+		return;
+
+	size_t new_frame, base_frame, changed_num, removed_num;
+	if (!get_size (payload, &pos, &new_frame) || !get_size (payload, &pos, &base_frame) || !get_size (payload, &pos, &changed_num))
+		return;
+	const Snapshot *base = NULL;
+	if (base_frame)
+	{
+		base = &history[base_frame % history.size ()];
+		//frame whose base is lost can't be decoded; server will use older acknowledged frame
+		if (base->frame != base_frame || new_frame <= base_frame || new_frame - base_frame >= history.size ())
+			return;
+	}
+	//frame is decoded aside and replaces slot of history only if it is complete, so base in that slot isn't lost
+	Snapshot &current = decoded;
+	current.Clear ();
+	current.frame = new_frame;
+	//changed and removed bodies are sorted by handle like bodies of base, so they are merged in one pass
+	size_t j = 0;
+	std::vector<size_t> &removed = removed_handles;
+	size_t changes_pos = pos;
+	for (size_t i = 0; i < changed_num; i++)
+	{
+		size_t handle, header;
+		long long value;
+		if (!get_size (payload, &pos, &handle) || !get_size (payload, &pos, &header))
+			return;
+		for (size_t k = 0; k < header / 2 * 2; k++)
+			if (!get_signed (payload, &pos, &value))
+				return;
+	}
+	//every handle takes at least one byte
+	if (!get_size (payload, &pos, &removed_num) || removed_num > payload.size () - pos)
+		return;
+	removed.resize (removed_num);
+	for (size_t i = 0; i < removed_num; i++)
+		if (!get_size (payload, &pos, &removed[i]))
+			return;
+
+	pos = changes_pos;
+	size_t r = 0;
+	for (size_t i = 0; i <= changed_num; i++)
+	{
+		size_t handle = (size_t)-1, header = 0;
+		if (i < changed_num)
+		{
+			get_size (payload, &pos, &handle);
+			get_size (payload, &pos, &header);
+		}
+		//bodies of base that didn't change
+		for (; base && j < base->Size () && base->handles[j] < handle; j++)
+		{
+			for (; r < removed.size () && removed[r] < base->handles[j]; r++);
+			if (r < removed.size () && removed[r] == base->handles[j])
+				continue;
+			current.handles.push_back (base->handles[j]);
+			current.coords.insert (current.coords.end (), base->coords.begin () + base->offsets[j], base->coords.begin () + base->offsets[j + 1]);
+			current.offsets.push_back (current.coords.size ());
+		}
+		if (i == changed_num)
+			break;
+		const long long *base_coords = NULL;
+		if (base && j < base->Size () && base->handles[j] == handle)
+		{
+			base_coords = &base->coords[base->offsets[j]];
+			j++;
+		}
+		size_t coords_num = header / 2 * 2;
+		if ((header & 1) && (!base_coords || base->offsets[j] - base->offsets[j - 1] != coords_num))
+			return;
+		current.handles.push_back (handle);
+		for (size_t k = 0; k < coords_num; k++)
+		{
+			long long value;
+			get_signed (payload, &pos, &value);
+			current.coords.push_back (value + ((header & 1) ? base_coords[k] : 0));
+		}
+		current.offsets.push_back (current.coords.size ());
+	}
+	std::swap (history[new_frame % history.size ()], decoded);
+	frame = new_frame;
+	frame_bytes = payload.size () + 5;
+	std::string ack;
+	put_varint (&ack, frame);
+	Send (MESSAGE_ACK, ack);
+}
+
+bool StateClient::Receive (int timeout)
+{
+	pollfd descriptor;
+	descriptor.fd = socket;
+	descriptor.events = POLLIN;
+	if (poll (&descriptor, 1, timeout) <= 0)
+		return true;
+	char buffer[65536];
+	while (true)
+	{
+		ssize_t received = recv (socket, buffer, sizeof (buffer), 0);
+		if (received == 0)
+			return false;
+		if (received < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				return false;
+			break;
+		}
+		input.append (buffer, received);
+	}
+	//stream with broken framing can't be synchronized again
+	return take_messages (&input, max_server_length, [this] (unsigned char type, const std::string &payload)
+	{
+		Parse (type, payload);
+	});
+}
+
+const Snapshot &StateClient::State ()
+{
+	return history[frame % history.size ()];
+}
+
+void StateClient::Spawn (vector2d center, double size)
+{
+	std::string payload;
+	put_double (&payload, center.x);
+	put_double (&payload, center.y);
+	put_double (&payload, size);
+	Send (MESSAGE_SPAWN, payload);
+}
+
+void StateClient::Drag (size_t handle, size_t point, vector2d position)
+{
+	std::string payload;
+	put_varint (&payload, handle);
+	put_varint (&payload, point);
+	put_double (&payload, position.x);
+	put_double (&payload, position.y);
+	Send (MESSAGE_DRAG, payload);
+}
+//----------end of implementation of state client----------
@@ -0,0 +1,212 @@
+/**
+@file
+@brief streaming of world state over Unix or TCP sockets
+@author Sergei Kachkov
+@note every message is uint32 length of the rest of message, uint8 type and payload; integers of payload
+are varints (zigzag varints for signed values), other numbers are doubles in byte order of host.
+Server sends MESSAGE_HELLO (quantum, timestep, static bodies, terrains) once and MESSAGE_FRAME every step;
+static bodies and terrains are arrays of polylines (number of points, points).
+Frame holds only bodies whose quantized points changed since base frame that was acknowledged by client:
+frame, base (0 - no base), changed bodies (handle, 2 * points + is_delta, coordinates), removed handles.
+Client sends MESSAGE_ACK (frame), MESSAGE_SPAWN (x, y, size) and MESSAGE_DRAG (handle, point, x, y).
+*/
+#pragma once
+#include <vector>
+#include <string>
+#include <map>
+#include "physics.h"
+
+enum MessageType
+{
+	MESSAGE_HELLO = 1,
+	MESSAGE_FRAME,
+	MESSAGE_ACK,
+	MESSAGE_SPAWN,
+	MESSAGE_DRAG
+};
+
+/**
+@class
+@brief quantized positions of points of all dynamic bodies at one frame; bodies are sorted by handles
+*/
+struct Snapshot
+{
+	size_t frame;
+	std::vector<size_t> handles;
+	/// coordinates of body i are coords[offsets[i]] .. coords[offsets[i + 1]]
+	std::vector<size_t> offsets;
+	std::vector<long long> coords;
+	Snapshot ();
+	void Clear ();
+	/**
+	@return index of body with handle in snapshot or size of snapshot, if body is absent
+	*/
+	size_t Find (size_t handle) const;
+	size_t Size () const
+	{
+		return handles.size ();
+	}
+};
+
+/**
+@class
+@brief command of client that should be applied to world before next step
+*/
+struct Command
+{
+	MessageType type;
+	size_t handle, point;
+	vector2d position;
+	double size;
+};
+
+/**
+@class
+@brief server that streams delta-compressed state of world to subscribed clients
+@note sockets are non-blocking; client whose socket is full skips frames and gets deltas against older base later
+*/
+class StateServer
+{
+private:
+	struct Client
+	{
+		int socket;
+		/// last frame acknowledged by client; 0 - none
+		size_t acked;
+		std::string input, output;
+		bool hello;
+	};
+	int listener;
+	std::string unix_path;
+	double quantum;
+	size_t frame;
+	std::vector<Client> clients;
+	/// the last snapshots; snapshot of frame f is history[f % size]
+	std::vector<Snapshot> history;
+	std::vector<size_t> order;
+	std::vector<Command> commands;
+	/// encoded frames of current step by their base frame
+	std::map<size_t, std::string> encoded;
+	void Accept ();
+	/**
+	@brief sends as much of output of client as socket takes
+	@return false, if client was disconnected
+	*/
+	bool Flush (Client &client);
+	/**
+	@brief reads messages of client and parses complete ones
+	@return false, if client was disconnected or sent message longer than any command
+	*/
+	bool Read (Client &client);
+	void Parse (Client &client, unsigned char type, const std::string &payload);
+	void Hello (Physics &world, std::string *message);
+	void Encode (const Snapshot &current, const Snapshot *base, std::string *message);
+	StateServer (const StateServer &);
+	StateServer &operator= (const StateServer &);
+public:
+	/**
+	@brief creates server without socket
+	@param quantum step of quantization of coordinates; body is sent when its quantized coordinates change
+	@param history number of frames that can be used as base of delta
+	*/
+	StateServer (double quantum = 0.001, size_t history = 32);
+	~StateServer ();
+	/**
+	@brief starts listening on Unix socket; existing file of socket is replaced
+	@param path path of socket file
+	*/
+	void ListenUnix (const char *path);
+	/**
+	@brief starts listening on TCP port of all interfaces
+	@param port number of port
+	*/
+	void ListenTcp (unsigned short port);
+	/**
+	@brief accepts clients, sends pending data and reads commands
+	@param timeout max time of waiting for events in milliseconds; 0 - don't wait
+	*/
+	void Poll (int timeout);
+	/**
+	@brief applies commands of clients that were read since last call: spawns boxes and drags points
+	@param world world to change
+	*/
+	void ApplyCommands (Physics &world);
+	/**
+	@brief makes snapshot of world and sends frame to every client that has sent all previous data
+	@param world world after step
+	*/
+	void Broadcast (Physics &world);
+	/**
+	@return number of connected clients
+	*/
+	size_t Clients ()
+	{
+		return clients.size ();
+	}
+};
+
+/**
+@class
+@brief client of state server; restores full state of world from frames and acknowledges them
+*/
+class StateClient
+{
+private:
+	int socket;
+	std::string input, output;
+	/// decoded frames that can be used as base of delta; frame f is history[f % size]
+	std::vector<Snapshot> history;
+	/// frame that is being decoded; it is swapped with slot of history when decoding succeeds
+	Snapshot decoded;
+	std::vector<size_t> removed_handles;
+	void Parse (unsigned char type, const std::string &payload);
+	void Send (unsigned char type, const std::string &payload);
+	StateClient (const StateClient &);
+	StateClient &operator= (const StateClient &);
+public:
+	/// step of quantization of coordinates
+	double quantum;
+	/// timestep of world
+	double timestep;
+	/// points of static bodies
+	std::vector<std::vector<vector2d> > statics;
+	/// vertexes of polylines of terrains
+	std::vector<std::vector<vector2d> > terrains;
+	/// number of the last decoded frame; 0 - no frames
+	size_t frame;
+	/// size of the last frame message in bytes
+	size_t frame_bytes;
+	/**
+	@param history number of decoded frames that are kept; it should be equal to history of server
+	*/
+	StateClient (size_t history = 32);
+	~StateClient ();
+	/**
+	@brief connects to Unix socket of server
+	@return false, if connection failed
+	*/
+	bool ConnectUnix (const char *path);
+	/**
+	@brief connects to TCP port of server
+	@return false, if connection failed
+	*/
+	bool ConnectTcp (const char *host, unsigned short port);
+	/**
+	@brief waits for data, decodes received frames and acknowledges them
+	@param timeout max time of waiting in milliseconds
+	@return false, if server closed connection or sent message with broken length
+	*/
+	bool Receive (int timeout);
+	/**
+	@return quantized state of the last frame; coordinate is quantum * value
+	*/
+	const Snapshot &State ();
+	/**
+	@brief asks server to add box
+	*/
+	void Spawn (vector2d center, double size);
+	/**
+	@brief asks server to move point of dynamic body
+	*/
+	void Drag (size_t handle, size_t point, vector2d position);
+};
@@ -0,0 +1,101 @@
+/**
+@file
+@brief implementation of graph of dependent tasks
+@author Sergei Kachkov
+*/
+#include <chrono>
+#include "taskgraph.h"
+#include "allocation.h"
+
+const size_t TaskGraph::null;
+
+TaskGraph::TaskGraph () :
+	count (0),
+	remaining_size (0),
+	run_pool (NULL),
+	run_timer (NULL)
+{
+}
+
+void TaskGraph::Clear ()
+{
+	count = 0;
+}
+
+size_t TaskGraph::Add (const char *name, size_t chunk, std::function<void ()> run)
+{
+	if (count == tasks.size ())
+		tasks.push_back (Task ());
+	Task &task = tasks[count];
+	task.run = std::move (run);
+	task.name = name;
+	task.chunk = chunk;
+	task.dependencies = 0;
+	task.successors.clear ();
+	return count++;
+}
+
+void TaskGraph::Depend (size_t task, size_t dependency)
+{
+	if (dependency == null)
+		return;
+	tasks[dependency].successors.push_back (task);
+	tasks[task].dependencies++;
+}
+
+void TaskGraph::RunTask (size_t task)
+{
+	Task &current = tasks[task];
+	const Timer &timer = *run_timer;
+	AllocationPhase phase (current.name);
+	if (timer)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+		current.run ();
+		timer (current.name, current.chunk, std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ());
+	}
+	else
+		current.run ();
+	for (size_t i = 0; i < current.successors.size (); i++)
+	{
+		size_t next = current.successors[i];
+		if (--remaining[next] == 0)
+		{
+			if (run_pool)
+				run_pool->Submit ([this, next] () { RunTask (next); });
+			else
+				ready.push_back (next);
+		}
+	}
+}
+
+void TaskGraph::Run (ThreadPool *pool, const Timer &timer)
+{
+	if (remaining_size < count)
+	{
+		remaining.reset (new std::atomic<size_t>[count]);
+		remaining_size = count;
+	}
+	run_pool = pool;
+	run_timer = &timer;
+	ready.clear ();
+	for (size_t i = 0; i < count; i++)
+	{
+		remaining[i] = tasks[i].dependencies;
+		if (!tasks[i].dependencies)
+			ready.push_back (i);
+	}
+	if (pool)
+	{
+		for (size_t i = 0; i < ready.size (); i++)
+		{
+			size_t task = ready[i];
+			pool->Submit ([this, task] () { RunTask (task); });
+		}
+		pool->Wait ();
+		return;
+	}
+	//ready tasks are run in order they became ready
+	for (size_t i = 0; i < ready.size (); i++)
+		RunTask (ready[i]);
+}
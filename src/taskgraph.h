@@ -0,0 +1,74 @@
+/**
+@file
+@brief graph of dependent tasks
+@author Sergei Kachkov
+*/
+#pragma once
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include "threadpool.h"
+
+/**
+@class
+@brief set of tasks with dependencies; task is started when all tasks that it depends on are finished
+@note graph can be filled again after Clear; memory of tasks is reused
+*/
+class TaskGraph
+{
+public:
+	/// function (task name, chunk, seconds) that gets running time of every task
+	typedef std::function<void (const char *, size_t, double)> Timer;
+private:
+	struct Task
+	{
+		std::function<void ()> run;
+		const char *name;
+		size_t chunk;
+		size_t dependencies;
+		std::vector<size_t> successors;
+	};
+	std::vector<Task> tasks;
+	size_t count;
+	std::unique_ptr<std::atomic<size_t>[]> remaining;
+	size_t remaining_size;
+	std::vector<size_t> ready;
+	/// pool and timer of current run; function objects of pool keep only graph and task, so they don't allocate
+	ThreadPool *run_pool;
+	const Timer *run_timer;
+	/**
+	@brief runs task and starts its successors that became ready
+	@param task index of task
+	@note allocations of task are counted in phase named by task
+	*/
+	void RunTask (size_t task);
+public:
+	static const size_t null = (size_t)-1;
+
+	TaskGraph ();
+	/**
+	@brief removes all tasks
+	*/
+	void Clear ();
+	/**
+	@brief adds task
+	@param name name of task for timing; must be static string
+	@param chunk index of part of data processed by task
+	@param run function object
+	@return index of task
+	*/
+	size_t Add (const char *name, size_t chunk, std::function<void ()> run);
+	/**
+	@brief task will be started after dependency
+	@param task, dependency indexes of tasks; null dependency is ignored
+	*/
+	void Depend (size_t task, size_t dependency);
+	/**
+	@brief runs all tasks
+	@param pool threads to run tasks; NULL - tasks run in calling thread in order of adding when it is possible
+	@param timer timing hook; it's called from threads of pool, so it must be thread-safe
+	@warning graph must be acyclic
+	*/
+	void Run (ThreadPool *pool, const Timer &timer);
+};
@@ -0,0 +1,147 @@
+/**
+@file
+@brief implementation of pool of threads with work stealing
+@author Sergei Kachkov
+*/
+#include <algorithm>
+#include "threadpool.h"
+
+/// pool and queue of current thread, if it is a worker
+static thread_local ThreadPool *current_pool = NULL;
+static thread_local size_t current_queue = 0;
+
+//----------implementation of queue------------------------
+void ThreadPool::Queue::PushBack (std::function<void ()> task)
+{
+	if (size == tasks.size ())
+	{
+		//tasks are moved to beginning of bigger buffer
+		std::vector<std::function<void ()> > bigger (std::max<size_t> (16, 2 * tasks.size ()));
+		for (size_t i = 0; i < size; i++)
+			bigger[i] = std::move (tasks[(first + i) % tasks.size ()]);
+		tasks.swap (bigger);
+		first = 0;
+	}
+	tasks[(first + size++) % tasks.size ()] = std::move (task);
+}
+
+std::function<void ()> ThreadPool::Queue::PopBack ()
+{
+	return std::move (tasks[(first + --size) % tasks.size ()]);
+}
+
+std::function<void ()> ThreadPool::Queue::PopFront ()
+{
+	std::function<void ()> task = std::move (tasks[first]);
+	first = (first + 1) % tasks.size ();
+	size--;
+	return task;
+}
+//----------end of implementation of queue-----------------
+
+ThreadPool::ThreadPool (unsigned int threads) :
+	queued (0),
+	pending (0),
+	next_queue (0),
+	stop (false)
+{
+	if (!threads)
+		threads = std::thread::hardware_concurrency ();
+	if (!threads)
+		threads = 1;
+	for (unsigned int i = 0; i < threads; i++)
+		queues.push_back (std::unique_ptr<Queue> (new Queue));
+	for (unsigned int i = 0; i < threads; i++)
+		this->threads.push_back (std::thread (&ThreadPool::WorkerLoop, this, i));
+}
+
+ThreadPool::~ThreadPool ()
+{
+	{
+		std::lock_guard<std::mutex> guard (wake_lock);
+		stop = true;
+	}
+	wake.notify_all ();
+	for (size_t i = 0; i < threads.size (); i++)
+		threads[i].join ();
+}
+
+void ThreadPool::Submit (std::function<void ()> task)
+{
+	pending++;
+	size_t queue;
+	if (current_pool == this)
+		queue = current_queue;
+	else
+	{
+		std::lock_guard<std::mutex> guard (wake_lock);
+		queue = next_queue;
+		next_queue = (next_queue + 1) % queues.size ();
+	}
+	{
+		std::lock_guard<std::mutex> guard (queues[queue]->lock);
+		queues[queue]->PushBack (std::move (task));
+	}
+	{
+		std::lock_guard<std::mutex> guard (wake_lock);
+		queued++;
+	}
+	wake.notify_one ();
+}
+
+bool ThreadPool::RunTask (size_t self)
+{
+	std::function<void ()> task;
+	//own queue from the newest task
+	if (self < queues.size ())
+	{
+		std::lock_guard<std::mutex> guard (queues[self]->lock);
+		if (queues[self]->size)
+			task = queues[self]->PopBack ();
+	}
+	//other queues from the oldest task
+	for (size_t i = 1; !task && i <= queues.size (); i++)
+	{
+		Queue &victim = *queues[(self + i) % queues.size ()];
+		std::lock_guard<std::mutex> guard (victim.lock);
+		if (victim.size)
+			task = victim.PopFront ();
+	}
+	if (!task)
+		return false;
+	queued--;
+	task ();
+	if (--pending == 0)
+	{
+		std::lock_guard<std::mutex> guard (wake_lock);
+		done.notify_all ();
+	}
+	return true;
+}
+
+void ThreadPool::WorkerLoop (size_t self)
+{
+	current_pool = this;
+	current_queue = self;
+	for (;;)
+	{
+		if (RunTask (self))
+			continue;
+		std::unique_lock<std::mutex> guard (wake_lock);
+		wake.wait (guard, [this] { return stop || queued > 0; });
+		if (stop)
+			return;
+	}
+}
+
+void ThreadPool::Wait ()
+{
+	//calling thread helps workers
+	while (pending > 0)
+	{
+		if (RunTask (queues.size ()))
+			continue;
+		std::unique_lock<std::mutex> guard (wake_lock);
+		done.wait (guard, [this] { return pending == 0 || queued > 0; });
+	}
+}
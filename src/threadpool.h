@@ -0,0 +1,83 @@
+/**
+@file
+@brief pool of threads with work stealing
+@author Sergei Kachkov
+*/
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+/**
+@class
+@brief persistent threads that run tasks from their own queues and steal tasks of each other
+@note worker takes the newest task of its queue and steals the oldest tasks of other queues;
+tasks submitted from tasks go to queue of current worker
+*/
+class ThreadPool
+{
+private:
+	/**
+	@brief ring buffer of tasks; it grows only, so steady flow of tasks doesn't allocate memory
+	*/
+	struct Queue
+	{
+		std::mutex lock;
+		std::vector<std::function<void ()> > tasks;
+		size_t first, size;
+		Queue () :
+			first (0),
+			size (0)
+		{ }
+		void PushBack (std::function<void ()> task);
+		std::function<void ()> PopBack ();
+		std::function<void ()> PopFront ();
+	};
+	std::vector<std::unique_ptr<Queue> > queues;
+	std::vector<std::thread> threads;
+	std::mutex wake_lock;
+	std::condition_variable wake, done;
+	/// tasks in queues
+	std::atomic<size_t> queued;
+	/// tasks that are queued or running
+	std::atomic<size_t> pending;
+	size_t next_queue;
+	bool stop;
+	/**
+	@brief runs one task of queue or steals task of other queue
+	@param self index of queue of current thread; number of queues for threads that are not workers
+	@return true, if task was run
+	*/
+	bool RunTask (size_t self);
+	void WorkerLoop (size_t self);
+	ThreadPool (const ThreadPool &);
+	ThreadPool &operator= (const ThreadPool &);
+public:
+	/**
+	@brief starts threads
+	@param threads number of threads; 0 - number of hardware threads
+	*/
+	ThreadPool (unsigned int threads);
+	~ThreadPool ();
+	/**
+	@return number of threads
+	*/
+	size_t Size ()
+	{
+		return threads.size ();
+	}
+	/**
+	@brief adds task to pool
+	@param task function object
+	*/
+	void Submit (std::function<void ()> task);
+	/**
+	@brief runs tasks until all submitted tasks are finished
+	@warning must not be called from task
+	*/
+	void Wait ();
+};